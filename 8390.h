@@ -11,8 +11,16 @@
 #include <linux/ioport.h>
 #include <linux/irqreturn.h>
 #include <linux/skbuff.h>
+#include <linux/workqueue.h>
 
 #define TX_PAGES 12	/* Two Tx slots */
+#define TX_STAGE_LEN 4	/* Frames staged per Tx queue before we stop it */
+#define TX_RESERVE_HOLD (HZ / 10) /* tx_reserve lasts this after a prio frame */
+
+/* Tx queues, see ei_set_tx_prio_map() */
+#define EI_TXQ_BULK	0
+#define EI_TXQ_PRIO	1
+#define EI_TX_QUEUES	2
 
 /* The 8390 specific per-packet-header format. */
 struct e8390_pkt_hdr {
@@ -23,7 +31,7 @@ struct e8390_pkt_hdr {
 
 #ifdef notdef
 extern int ei_debug;
-#else
+#elif !defined(ei_debug)
 #define ei_debug 1
 #endif
 
@@ -69,39 +77,120 @@ static inline struct net_device *alloc_eip_netdev(void)
 	return __alloc_eip_netdev(0);
 }
 
-/* You have one of these per-board */
+/* Resolution of the Rx ring fill histogram */
+#define EI_RX_FILL_NR	8
+
+/* Tx watchdog recovery levels, cheapest first; see __ei_tx_timeout(). */
+enum ei_tx_recover {
+	EI_TXREC_RETRY,		/* service a lost Tx interrupt or re-kick the send */
+	EI_TXREC_ABORT,		/* divert the stuck frame through TXCR loopback */
+	EI_TXREC_RESET,		/* full chip reset, loses the Rx ring */
+	EI_TXREC_NR
+};
+
+/*
+ * You have one of these per-board. The fields the interrupt handler and
+ * the Tx path touch for every frame come first, so they share a couple
+ * of cache lines; setup-time and error-path state follows. Flags are
+ * whole bytes rather than bitfields so that updating one never rewrites
+ * a word another path is reading.
+ */
 struct ei_device {
-	const char *name;
-	void (*reset_8390)(struct net_device *);
+	/* hot: per-frame state */
+	void __iomem *mem;
+	u32 *reg_offset;		/* Register mapping table */
+#ifdef AX88796_PLATFORM
+	const struct ax_bus_ops *bus_ops; /* Bus front end accessors */
+#endif
+	spinlock_t page_lock;		/* Page register locks */
+	unsigned char current_page;	/* Read pointer in buffer  */
+	unsigned char tx_start_page, rx_start_page, stop_page;
+	short tx1, tx2;			/* Packet lengths for ping-pong tx. */
+	short lasttx;			/* Alpha version consistency check. */
+	unsigned char txing;		/* Transmit Active */
+	unsigned char irqlock;		/* 8390's intrs disabled when '1'. */
+	unsigned char isr_lost;		/* ISR bits masked by an injected fault */
+	unsigned char dmaing;		/* Remote DMA Active */
+	unsigned char txqueue;		/* Tx Packet buffer queue length. */
+	unsigned char rx_high_water;	/* drain Rx before Tx above this; 0 = off */
+	unsigned char rx_check;		/* ei_tx_make_room() due in this Tx burst */
+	unsigned char tx_reserve;	/* keep a Tx slot free for EI_TXQ_PRIO */
+	unsigned long tx_reserve_until;	/* jiffies: priority traffic seen until */
+#ifdef AX88796_PLATFORM
+	unsigned char rxcr_base;	/* default value for RXCR */
+	unsigned char txcr_base;	/* default value for TXCR */
+#endif
+	struct sk_buff_head tx_stage[EI_TX_QUEUES]; /* Frames waiting for a Tx slot */
+	struct sk_buff *tx_skb[2];	/* on the card, awaiting a completion stamp */
+	ktime_t rx_stamp;		/* entry of the interrupt being served, or 0 */
 	void (*get_8390_hdr)(struct net_device *, struct e8390_pkt_hdr *, int);
-	void (*block_output)(struct net_device *, int, const unsigned char *, int);
+	int (*block_output)(struct net_device *, int, const unsigned char *, int);
 	void (*block_input)(struct net_device *, int, struct sk_buff *, int);
+
+	/* cold: setup, reconfiguration and error handling */
+	const char *name;
+	void (*reset_8390)(struct net_device *);
 	unsigned long rmem_start;
 	unsigned long rmem_end;
-	void __iomem *mem;
 	unsigned char mcfilter[8];
-	unsigned open:1;
-	unsigned word16:1;  		/* We have the 16-bit (vs 8-bit) version of the card. */
-	unsigned bigendian:1;		/* 16-bit big endian mode. Do NOT */
+	unsigned char open;
+	unsigned char word16;		/* We have the 16-bit (vs 8-bit) version of the card. */
+	unsigned char bigendian;	/* 16-bit big endian mode. Do NOT */
 					/* set this on random 8390 clones! */
-	unsigned txing:1;		/* Transmit Active */
-	unsigned irqlock:1;		/* 8390's intrs disabled when '1'. */
-	unsigned dmaing:1;		/* Remote DMA Active */
-	unsigned char tx_start_page, rx_start_page, stop_page;
-	unsigned char current_page;	/* Read pointer in buffer  */
 	unsigned char interface_num;	/* Net port (AUI, 10bT.) to use. */
-	unsigned char txqueue;		/* Tx Packet buffer queue length. */
-	short tx1, tx2;			/* Packet lengths for ping-pong tx. */
-	short lasttx;			/* Alpha version consistency check. */
-	unsigned char reg0;		/* Register '0' in a WD8013 */
-	unsigned char reg5;		/* Register '5' in a WD8013 */
 	unsigned char saved_irq;	/* Original dev->irq value. */
-	u32 *reg_offset;		/* Register mapping table */
-	spinlock_t page_lock;		/* Page register locks */
 	unsigned long priv;		/* Private field to store bus IDs etc. */
-#ifdef AX88796_PLATFORM
-	unsigned char rxcr_base;	/* default value for RXCR */
-#endif
+	unsigned char tx_recover_level;	/* next ei_tx_recover step to try */
+	unsigned long tx_recover[EI_TXREC_NR]; /* watchdog recoveries, by level */
+	unsigned long rx_drain_tx;	/* Tx uploads preceded by an Rx drain */
+	unsigned long rx_fill[EI_RX_FILL_NR]; /* Rx ring fill, in eighths, per Rx run */
+	struct net_device *dev;		/* Back pointer for the Tx worker */
+	struct work_struct tx_work;	/* Uploads staged frames to the card */
+};
+
+/* Logical operations, for boards that profile their register accesses. */
+enum ei_prof_op {
+	EI_PROF_RX,		/* one received frame */
+	EI_PROF_TX,		/* one transmitted frame */
+	EI_PROF_IRQ,		/* one interrupt round */
+	EI_PROF_MCAST,		/* multicast filter update */
+	EI_PROF_STATS,		/* counter register read */
+	EI_PROF_NR
+};
+
+/* Hot path stages, for boards that time them. */
+enum ei_stage {
+	EI_STAGE_IRQ,		/* one interrupt handler run */
+	EI_STAGE_HDR,		/* Rx header fetch */
+	EI_STAGE_ALLOC,		/* Rx skb allocation */
+	EI_STAGE_RX_COPY,	/* Rx payload copy */
+	EI_STAGE_NETIF_RX,	/* hand-off to the stack */
+	EI_STAGE_UPLOAD,	/* Tx upload, including the RDC wait */
+	EI_STAGE_RDC,		/* Tx wait for remote DMA complete */
+	EI_STAGE_TRIGGER,	/* Tx start command */
+	EI_STAGE_NR
+};
+
+/* Sections run with the IRQ line or the 8390's IMR off, and the handler. */
+enum ei_window {
+	EI_WIN_HARDIRQ,		/* one interrupt handler run */
+	EI_WIN_TX,		/* card claimed for Tx uploads */
+	EI_WIN_TIMEOUT,		/* Tx watchdog recovery */
+	EI_WIN_OVERRUN,		/* Rx overrun recovery, inside the handler */
+	EI_WIN_STATS,		/* counter read, local irqs off */
+	EI_WIN_MCAST,		/* multicast filter load, local irqs off */
+	EI_WIN_NR
+};
+
+/* Error recovery paths, for boards that time them or inject faults. */
+enum ei_fault {
+	EI_FAULT_RX_OVERRUN,	/* receiver overrun: stop, drain, restart */
+	EI_FAULT_RX_PAGE,	/* Rx header link or read pointer out of step */
+	EI_FAULT_RX_BOGUS,	/* Rx header with a bad status or length */
+	EI_FAULT_TX_TIMEOUT,	/* Tx watchdog after a lost completion */
+	EI_FAULT_RESET,		/* reset and reinit; injected: reset never completes */
+	EI_FAULT_RDC,		/* Tx upload without remote DMA complete */
+	EI_FAULT_NR
 };
 
 /* The maximum number of 8390 interrupt service routines called per IRQ. */
@@ -124,8 +213,13 @@ struct ei_device {
 #define E8390_RXOFF		0x20	/* EN0_RXCR: Accept no packets */
 #endif
 
+#ifdef AX88796_PLATFORM
+#define E8390_TXCONFIG		(ei_status.txcr_base)
+#define E8390_TXOFF		(ei_status.txcr_base | 0x02)
+#else
 #define E8390_TXCONFIG		0x00	/* EN0_TXCR: Normal transmit mode */
 #define E8390_TXOFF		0x02	/* EN0_TXCR: Transmitter off */
+#endif
 
 
 /*  Register accessed at EN_CMD, the 8390 base addr.  */
@@ -27,8 +27,21 @@
 #include <linux/phy.h>
 #include <linux/eeprom_93cx6.h>
 #include <linux/slab.h>
+#include <linux/pci.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#ifdef CONFIG_ZORRO
 #include <linux/zorro.h>
 #include <asm/amigaints.h>
+#endif
+#ifdef CONFIG_AX88796_UIO
+#include <linux/uio_driver.h>
+#endif
+#ifdef CONFIG_AX88796_FAULT_INJECT
+#include <linux/fault-inject.h>
+#endif
 
 #include <net/ax88796.h>
 
@@ -45,20 +58,225 @@
 #define ____alloc_ei_netdev ax__alloc_ei_netdev
 #define __NS8390_init ax_NS8390_init
 
+#if defined(CONFIG_AX88796_XSURF_ONLY) && !defined(CONFIG_ZORRO)
+#error "CONFIG_AX88796_XSURF_ONLY needs Zorro bus support"
+#endif
+
+#if defined(CONFIG_PCI) && !defined(CONFIG_AX88796_XSURF_ONLY)
+#define AX_HAVE_PCI
+#endif
+
+#define XS100_IRQSTATUS_BASE 0x40
+/*  Base address of 8390 compatible registers in X-Surf 100 space */
+#define XS100_8390_BASE 0x800
+
+/* Longword-access area. Translated to 2 16-bit access cycles by the
+   X-Surf 100 FPGA */
+#define XS100_8390_DATA32_BASE 0x8000
+#define XS100_8390_DATA32_SIZE 0x2000
+/* Sub-Areas for fast data register access; addresses relative to area begin */
+#define XS100_8390_DATA_READ32_BASE 0x0880
+#define XS100_8390_DATA_WRITE32_BASE 0x0C80
+#define XS100_8390_DATA_AREA_SIZE 0x80
+
+
 /* force unsigned long back to 'void __iomem *' */
 #define ax_convert_addr(_a) ((void __force __iomem *)(_a))
 
-#define ei_inb(_a) z_readb(ax_convert_addr(_a))
-#define ei_outb(_v, _a) z_writeb(_v, ax_convert_addr(_a))
+/*
+ * Bus front end. The AX88796 engine reaches the card only through one of
+ * these: a Zorro one for the X-Surf 100 and a PCI one for NE2000 clones
+ * such as the RTL8029 that QEMU emulates. Register offsets are
+ * reg_base + reg_stride * n.
+ */
+struct ax_bus_ops {
+	const char *name;
+	u8 (*readb)(const void __iomem *addr);
+	void (*writeb)(u8 val, void __iomem *addr);
+	void (*read_data)(struct net_device *dev, void *dst, unsigned count);
+	void (*write_data)(struct net_device *dev, const void *src, unsigned count);
+	bool (*irq_pending)(struct net_device *dev);	/* NULL: always ask the chip */
+	int (*request_irq)(struct net_device *dev);	/* NULL: request dev->irq */
+	void (*free_irq)(struct net_device *dev);
+	void (*calibrate)(struct net_device *dev, int page);
+	unsigned int reg_base;
+	unsigned int reg_stride;
+	bool has_mii;			/* AX88796 MEMR/GPOC registers present */
+};
+
+/*
+ * CONFIG_AX88796_XSURF_ONLY builds the driver for the X-Surf 100 alone.
+ * The bus ops then come from a constant table the compiler can see, so
+ * register offsets, ops calls and has_mii fold away, lib8390 calls the
+ * block routines directly and the ei_debug checks compile out.
+ */
+#ifdef CONFIG_AX88796_XSURF_ONLY
+struct e8390_pkt_hdr;
+static const struct ax_bus_ops xs100_bus_ops;
+static void ax_reset_8390(struct net_device *dev);
+static void ax_get_8390_hdr(struct net_device *dev, struct e8390_pkt_hdr *hdr,
+			    int ring_page);
+static void ax_block_input(struct net_device *dev, int count,
+			   struct sk_buff *skb, int ring_offset);
+static int ax_block_output(struct net_device *dev, int count,
+			   const unsigned char *buf, const int start_page);
+
+#define ax_bus(ei_local) ((void)(ei_local), &xs100_bus_ops)
+#define ei_reset_8390 ax_reset_8390
+#define ei_get_8390_hdr ax_get_8390_hdr
+#define ei_block_input ax_block_input
+#define ei_block_output ax_block_output
+#define ei_word16(ei_local) 1
+#define ei_bigendian(ei_local) 0
+#define ei_debug 0
+#else
+#define ax_bus(ei_local) ((ei_local)->bus_ops)
+#endif
+
+/*
+ * Raw Zorro accessors used by the X-Surf 100 front end, so the driver
+ * core can be built against a software model of the AX88796 by defining
+ * them before this point, as tools/ax88796-bench does.
+ */
+#ifndef ax_readb
+#define ax_readb(_a) z_readb(_a)
+#define ax_writeb(_v, _a) z_writeb(_v, _a)
+#define ax_readw(_a) z_readw(_a)
+#define ax_writew(_v, _a) z_writew(_v, _a)
+#define ax_readl(_a) z_readl(_a)
+#define ax_writel(_v, _a) z_writel(_v, _a)
+#endif
+
+/*
+ * 8390 register accessors. CONFIG_AX88796_TRACE records each access in
+ * a per board ring, see ax_trace(), together with the FIFO data and the
+ * points where the driver core was entered, so that tools/ax88796-replay
+ * can run a capture through it again.
+ */
+#ifdef CONFIG_AX88796_TRACE
+enum {
+	AX_TR_RD8, AX_TR_WR8, AX_TR_RD16, AX_TR_WR16,
+	AX_TR_FIFO_IN, AX_TR_FIFO_OUT,	/* value is the byte count */
+	AX_TR_DATA,			/* next 4 bytes of that burst */
+	AX_TR_ENTER, AX_TR_LEAVE,	/* value is an AX_CTX_* */
+	AX_TR_XMIT,			/* offset: queue, value: length */
+	AX_TR_KINDS
+};
+
+/* driver core entry points, as marked in the trace */
+enum {
+	AX_CTX_OPEN,			/* ax_ei_open() */
+	AX_CTX_CLOSE,			/* ax_ei_close() */
+	AX_CTX_IRQ,			/* ax_ei_interrupt() */
+	AX_CTX_TX_WORK,			/* ei_tx_work() */
+	AX_CTX_TX_TIMEOUT,		/* ax_ei_tx_timeout() */
+	AX_CTX_NR
+};
+
+struct ei_device;
+static void ax_trace(struct ei_device *ei_local, int kind,
+		     unsigned int off, unsigned int val);
+static void ax_trace_data(struct ei_device *ei_local, int kind,
+			  const void *buf, unsigned int n);
+
+#define ax_rd8(_a) ({							\
+	void __iomem *__a = ax_convert_addr(_a);			\
+	u8 __v = ax_bus(ei_local)->readb(__a);				\
+	ax_trace(ei_local, AX_TR_RD8, __a - ei_local->mem, __v);	\
+	__v; })
+#define ax_wr8(_v, _a) do {						\
+	void __iomem *__a = ax_convert_addr(_a);			\
+	u8 __v = (_v);							\
+	ax_trace(ei_local, AX_TR_WR8, __a - ei_local->mem, __v);	\
+	ax_bus(ei_local)->writeb(__v, __a);				\
+} while (0)
+#define ax_rd16(_a) ({							\
+	void __iomem *__a = ax_convert_addr(_a);			\
+	u16 __v = ax_readw(__a);					\
+	ax_trace(ei_local, AX_TR_RD16, __a - ei_local->mem, __v);	\
+	__v; })
+#define ax_wr16(_v, _a) do {						\
+	void __iomem *__a = ax_convert_addr(_a);			\
+	u16 __v = (_v);							\
+	ax_trace(ei_local, AX_TR_WR16, __a - ei_local->mem, __v);	\
+	ax_writew(__v, __a);						\
+} while (0)
+#define ax_trace_fifo(kind, buf, n) ax_trace_data(ei_local, kind, buf, n)
+#define ax_trace_enter(ei_local, ctx) ax_trace(ei_local, AX_TR_ENTER, 0, ctx)
+#define ax_trace_leave(ei_local, ctx) ax_trace(ei_local, AX_TR_LEAVE, 0, ctx)
+#define ax_trace_xmit(ei_local, skb)					\
+	ax_trace(ei_local, AX_TR_XMIT, skb_get_queue_mapping(skb), (skb)->len)
+#else
+#define ax_rd8(_a) ax_bus(ei_local)->readb(ax_convert_addr(_a))
+#define ax_wr8(_v, _a) ax_bus(ei_local)->writeb(_v, ax_convert_addr(_a))
+#define ax_rd16(_a) ax_readw(ax_convert_addr(_a))
+#define ax_wr16(_v, _a) ax_writew(_v, ax_convert_addr(_a))
+#define ax_trace_fifo(kind, buf, n) do { } while (0)
+#define ax_trace_enter(ei_local, ctx) ((void)(ei_local))
+#define ax_trace_leave(ei_local, ctx) ((void)(ei_local))
+#define ax_trace_xmit(ei_local, skb) ((void)(ei_local))
+#endif
+
+#ifdef CONFIG_AX88796_PROFILE
+enum { AX_PROF_READ, AX_PROF_WRITE, AX_PROF_FIFO, AX_PROF_KINDS };
+
+static void ax_prof_access(const char *site, int kind, unsigned int n);
+static void ax_prof_begin(int op);
+static void ax_prof_end(int op);
+
+#define ei_inb(_a) (ax_prof_access(__func__, AX_PROF_READ, 1), ax_rd8(_a))
+#define ei_outb(_v, _a) do {						\
+	ax_prof_access(__func__, AX_PROF_WRITE, 1);			\
+	ax_wr8(_v, _a);							\
+} while (0)
+
+#define ei_inw(_a) (ax_prof_access(__func__, AX_PROF_READ, 1), ax_rd16(_a))
+#define ei_outw(_v, _a) do {						\
+	ax_prof_access(__func__, AX_PROF_WRITE, 1);			\
+	ax_wr16(_v, _a);						\
+} while (0)
+
+#define ei_prof_begin(dev, op) ax_prof_begin(op)
+#define ei_prof_end(dev, op) ax_prof_end(op)
+#define ax_prof_fifo(n) ax_prof_access(__func__, AX_PROF_FIFO, (n) / 4)
+#else
+#define ei_inb(_a) ax_rd8(_a)
+#define ei_outb(_v, _a) ax_wr8(_v, _a)
+
+#define ei_inw(_a) ax_rd16(_a)
+#define ei_outw(_v, _a) ax_wr16(_v, _a)
 
-#define ei_inw(_a) z_readw(ax_convert_addr(_a))
-#define ei_outw(_v, _a) z_writew(_v, ax_convert_addr(_a))
+#define ax_prof_fifo(n) do { } while (0)
+#endif
+
+static void ax_tx_status(struct net_device *dev, unsigned char txsr);
+#define ei_tx_status(dev, txsr) ax_tx_status(dev, txsr)
+
+static u64 ax_stage_clock(void);
+static void ax_stage_add(struct net_device *dev, int stage, u64 t0);
+#define ei_stage_clock(dev) ax_stage_clock()
+#define ei_stage_add(dev, stage, t0) ax_stage_add(dev, stage, t0)
+
+static void ax_window_end(struct net_device *dev, int win, u64 t0);
+#define ei_window_begin(dev) ktime_get_ns()
+#define ei_window_end(dev, win, t0) ax_window_end(dev, win, t0)
+
+static bool ax_fail(struct net_device *dev, int fault);
+static void ax_recover_begin(struct net_device *dev, int fault);
+static void ax_recover_end(struct net_device *dev, int fault);
+#define ei_fail(dev, fault) ax_fail(dev, fault)
+#define ei_recover_begin(dev, fault) ax_recover_begin(dev, fault)
+#define ei_recover_end(dev, fault) ax_recover_end(dev, fault)
 
 #define ei_inb_p(_a) ei_inb(_a)
 #define ei_outb_p(_v, _a) ei_outb(_v, _a)
 
+#ifdef CONFIG_AX88796_XSURF_ONLY
+#define EI_SHIFT(x) (XS100_8390_BASE + 4 * (x))
+#else
 /* define EI_SHIFT() to take into account our register offsets */
 #define EI_SHIFT(x) (ei_local->reg_offset[(x)])
+#endif
 
 /* Ensure we have our RCR base value */
 #define AX88796_PLATFORM
@@ -82,46 +300,150 @@ static unsigned char version[] = "ax88796.c: Copyright 2005,2007 Simtec Electron
 
 #define AX_GPOC_PPDSET	BIT(6)
 
-#define XS100_IRQSTATUS_BASE 0x40
-/*  Base address of 8390 compatible registers in X-Surf 100 space */
-#define XS100_8390_BASE 0x800
+#define AX_TXCR_FDU	BIT(7)	/* MAC full duplex, no CSMA/CD */
 
-/* Longword-access area. Translated to 2 16-bit access cycles by the
-   X-Surf 100 FPGA */
-#define XS100_8390_DATA32_BASE 0x8000
-#define XS100_8390_DATA32_SIZE 0x2000
-/* Sub-Areas for fast data register access; addresses relative to area begin */
-#define XS100_8390_DATA_READ32_BASE 0x0880
-#define XS100_8390_DATA_WRITE32_BASE 0x0C80
-#define XS100_8390_DATA_AREA_SIZE 0x80
+static bool keep_phy_powered;
+module_param(keep_phy_powered, bool, 0644);
+MODULE_PARM_DESC(keep_phy_powered, "Leave the PHY up while the interface is down");
+
+static unsigned int rx_watermark = 75;
+module_param(rx_watermark, uint, 0444);
+MODULE_PARM_DESC(rx_watermark, "Rx ring fill (percent) above which Rx is drained before Tx uploads, 0 to disable");
+
+static unsigned int dma_chunk = 512;
+module_param(dma_chunk, uint, 0644);
+MODULE_PARM_DESC(dma_chunk, "Tx upload chunk in bytes (multiple of 64) between Rx ring checks, 0 for whole frames");
+
+static bool tx_reserve;
+module_param(tx_reserve, bool, 0444);
+MODULE_PARM_DESC(tx_reserve, "Keep one Tx slot free while the priority Tx queue is in use");
+
+static bool rx_timestamp;
+module_param(rx_timestamp, bool, 0644);
+MODULE_PARM_DESC(rx_timestamp, "Timestamp received frames at interrupt entry instead of in the stack");
+
+static bool stage_timing;
+module_param(stage_timing, bool, 0644);
+MODULE_PARM_DESC(stage_timing, "Time the Rx/Tx hot path stages and remote DMA, see sysfs ax88796/");
+
+static struct dentry *ax_debugfs_root;
+
+#define AX_WIN_BUCKETS	24	/* log2 of microseconds, see ax_window_end() */
+
+#ifdef CONFIG_AX88796_TRACE
+static unsigned int trace;
+module_param(trace, uint, 0644);
+MODULE_PARM_DESC(trace, "Record register accesses: 1 keeps the newest, 2 stops when full; see debugfs ax88796/*/trace");
+
+static unsigned int trace_entries = 16384;
+module_param(trace_entries, uint, 0444);
+MODULE_PARM_DESC(trace_entries, "Trace records kept per board");
+
+static unsigned int trace_data = 64;
+module_param(trace_data, uint, 0644);
+MODULE_PARM_DESC(trace_data, "FIFO bytes recorded from the start of each burst");
+
+struct ax_trace_rec {
+	u64 ns;
+	u32 off;			/* from ei_device.mem, or in the burst */
+	union {
+		u32 val;
+		u8 data[4];		/* AX_TR_DATA */
+	};
+	u8 kind;
+};
+#endif
 
 static int ax_mii_init(struct net_device *dev);
 
 /* device private data */
 
+/* remote DMA job types, see ax_dma_submit() */
+enum ax_dma_op {
+	AX_DMA_RX_HDR,
+	AX_DMA_RX_DATA,
+	AX_DMA_TX,
+	AX_DMA_PROM,
+};
+
 struct ax_device {
-	struct mii_bus *mii_bus;
-	struct mdiobb_ctrl bb_ctrl;
-	struct phy_device *phy_dev;
-	void __iomem *addr_memr;
+	/* hot: per-frame data path, see struct ei_device */
+	void __iomem *xs100irqstatusreg;
+	void __iomem *data_area;
+	void __iomem *xs100readfifo;
+	void __iomem *xs100writefifo;
+
+	/* FIFO copy kernels, indexed by buffer alignment (AX_ALIGN_IDX) */
+	void (*fifo_in[2])(void *dst, const void __iomem *fifo, unsigned count);
+	void (*fifo_out[2])(void __iomem *fifo, const void *src, unsigned count);
+	unsigned char tiny_in;		/* reads up to this size use NE_DATAPORT */
+	unsigned char running;
+	unsigned char testing;		/* ax_self_test() owns the ring */
+
+	/* Tx outcome by MAC duplex, indexed by ax_device.duplex == DUPLEX_FULL */
+	unsigned long tx_frames[2];
+	unsigned long tx_collisions[2];
+	unsigned long tx_aborts[2];
+	unsigned long tx_late_collisions[2];
+
+	/* cold: link management and setup */
 	u8 reg_memr;
 	int link;
 	int speed;
 	int duplex;
+	struct mii_bus *mii_bus;	/* set up by mii_work after probe */
+	struct work_struct mii_work;
+	struct mdiobb_ctrl bb_ctrl;
+	struct phy_device *phy_dev;
+	struct delayed_work link_work;	/* GPI link watch, see ax_link_work() */
+	unsigned long link_resync;
+	u8 gpi;
+	void __iomem *addr_memr;
 
 	void __iomem *map2;
 	const struct ax_plat_data *plat;
 
-	unsigned char running;
 	unsigned char resume_open;
 	unsigned int irqflags;
+	unsigned long irq_spurious;	/* our line asserted, 8390 had nothing */
+	unsigned long dma_tx_yield;	/* Rx drains between Tx upload chunks */
+
+	/* stage_timing accounting, see ax_stage_add() */
+	u64 stage_ns[EI_STAGE_NR];
+	unsigned long stage_n[EI_STAGE_NR];
+	u64 bus_ns;			/* remote DMA transfers and RDC waits */
+	u64 bus_bytes;
+	u64 acct_start;
+
+	/* interrupt-off sections, see ax_window_end() */
+	unsigned long win_n[EI_WIN_NR];
+	u64 win_max[EI_WIN_NR];
+	unsigned long win_hist[EI_WIN_NR][AX_WIN_BUCKETS];
+
+	/* error recovery paths, see ax_recover_end() */
+	u64 rec_t0[EI_FAULT_NR];	/* start of the run in progress */
+	unsigned long rec_lost0[EI_FAULT_NR];
+	unsigned long rec_n[EI_FAULT_NR];
+	unsigned long rec_injected[EI_FAULT_NR];
+	u64 rec_ns[EI_FAULT_NR];
+	u64 rec_max[EI_FAULT_NR];
+	unsigned long rec_lost[EI_FAULT_NR];
+	struct dentry *debugfs;		/* per board dir under ax_debugfs_root */
+#ifdef CONFIG_AX88796_TRACE
+	struct ax_trace_rec *trace;	/* ring of trace_entries */
+	unsigned long trace_head;	/* total recorded */
+	spinlock_t trace_lock;
+#endif
+#ifdef CONFIG_ZORRO
+	struct list_head xs100_node;	/* on xs100_boards while open */
+#endif
+#ifdef CONFIG_AX88796_UIO
+	struct uio_info *uio;		/* set in UIO mode instead of a netdev */
+#endif
 
+#ifndef CONFIG_AX88796_XSURF_ONLY
 	u32 reg_offsets[0x20];
-
-	void __iomem *xs100irqstatusreg;
-	void __iomem *data_area;
-	void __iomem *xs100readfifo;
-	void __iomem *xs100writefifo;
+#endif
 };
 
 static inline struct ax_device *to_ax_dev(struct net_device *dev)
@@ -130,87 +452,186 @@ static inline struct ax_device *to_ax_dev(struct net_device *dev)
 	return (struct ax_device *)(ei_local + 1);
 }
 
-/* These functions guarantee that the iomem is accessed with 32 bit
-   cycles only. z_memcpy_fromio / z_memcpy_toio don't */
-static void z_memcpy_fromio32(void *dst, const void __iomem *src, size_t bytes)
+static inline struct ei_device *ax_to_ei(struct ax_device *ax)
 {
-	while(bytes > 32)
-	{
-		asm __volatile__ (
-                    "movem.l (%0)+,%%d0-%%d7\n"
-		    "movem.l %%d0-%%d7,(%1)\n"
-		    "adda.l #32,%1" : "=a"(src), "=a"(dst)
-		    : "0"(src), "1"(dst) : "d0","d1","d2","d3","d4","d5","d6","d7","memory");
-		bytes -= 32;
-	}
-	while(bytes)
-	{
-		*(uint32_t*)dst = z_readl(src);
-		src += 4;
-		dst += 4;
-		bytes -= 4;
-	}
+	return (struct ei_device *)ax - 1;
 }
 
-static void z_memcpy_toio32(void __iomem *dst, const void *src, size_t bytes)
+/*
+ * Hot path stage timing. lib8390 brackets each stage with
+ * ei_stage_clock()/ei_stage_add() and the remote DMA engine adds its
+ * transfers to the bus meter. A zero stamp means stage_timing was off
+ * when the stage began. Updated with page_lock held.
+ */
+static u64 ax_stage_clock(void)
 {
-	while(bytes)
-	{
-		z_writel(*(const uint32_t*)src, dst);
-		src += 4;
-		dst += 4;
-		bytes -= 4;
-	}
+	return stage_timing ? ktime_get_ns() : 0;
 }
 
-static void xs100_write(struct net_device *dev, const void *src, unsigned count)
+static void ax_stage_add(struct net_device *dev, int stage, u64 t0)
 {
-	struct ei_device *ei_local = netdev_priv(dev);
 	struct ax_device *ax = to_ax_dev(dev);
-	/* copy whole blocks */
-	while(count > XS100_8390_DATA_AREA_SIZE)
-	{
-		z_memcpy_toio32(ax->xs100writefifo, src, XS100_8390_DATA_AREA_SIZE);
-		src += XS100_8390_DATA_AREA_SIZE;
-		count -= XS100_8390_DATA_AREA_SIZE;
-	}
-	/* copy whole dwords */
-	z_memcpy_toio32(ax->xs100writefifo, src, count & ~3);
-	src += count & ~3;
-	if(count & 2)
-	{
-		ei_outw(*(uint16_t*)src, ei_local->mem + NE_DATAPORT);
-		src += 2;
-	}
-	if(count & 1)
-	{
-		ei_outb(*(uint8_t*)src, ei_local->mem + NE_DATAPORT);
-	}
+
+	if (!t0)
+		return;
+
+	ax->stage_ns[stage] += ktime_get_ns() - t0;
+	ax->stage_n[stage]++;
 }
 
-static void xs100_read(struct net_device *dev, void *dst, unsigned count)
+/*
+ * Every section lib8390 runs with our IRQ line disabled, the IMR masked
+ * or local interrupts off, and every handler run, goes into a log2
+ * histogram of microseconds (bucket n: < 2^n us) in debugfs, to show
+ * how long we keep other devices on the line, or the CPU, waiting.
+ */
+static void ax_window_end(struct net_device *dev, int win, u64 t0)
 {
-	struct ei_device *ei_local = netdev_priv(dev);
 	struct ax_device *ax = to_ax_dev(dev);
-	/* copy whole blocks */
-	while(count > XS100_8390_DATA_AREA_SIZE)
-	{
-		z_memcpy_fromio32(dst, ax->xs100readfifo, XS100_8390_DATA_AREA_SIZE);
-		dst += XS100_8390_DATA_AREA_SIZE;
-		count -= XS100_8390_DATA_AREA_SIZE;
-	}
-	/* copy whole dwords */
-	z_memcpy_fromio32(dst, ax->xs100readfifo, count & ~3);
-	dst += count & ~3;
-	if(count & 2)
-	{
-		*(uint16_t*)dst = ei_inw(ei_local->mem + NE_DATAPORT);
-		dst += 2;
+	u64 ns = ktime_get_ns() - t0;
+	u32 us = min_t(u64, div_u64(ns, NSEC_PER_USEC), U32_MAX);
+
+	ax->win_n[win]++;
+	ax->win_hist[win][min_t(int, fls(us), AX_WIN_BUCKETS - 1)]++;
+	if (ns > ax->win_max[win])
+		ax->win_max[win] = ns;
+}
+
+#ifdef CONFIG_AX88796_FAULT_INJECT
+/*
+ * One fault_attr per recovery path, shared by all boards and set up
+ * through debugfs ax88796/fail_*, see fault-injection.txt.
+ */
+static struct fault_attr ax_fail_attr[EI_FAULT_NR] = {
+	[0 ... EI_FAULT_NR - 1] = FAULT_ATTR_INITIALIZER,
+};
+
+static bool ax_fail(struct net_device *dev, int fault)
+{
+	if (!should_fail(&ax_fail_attr[fault], 1))
+		return false;
+
+	to_ax_dev(dev)->rec_injected[fault]++;
+	return true;
+}
+#else
+static inline bool ax_fail(struct net_device *dev, int fault)
+{
+	return false;
+}
+#endif
+
+/* frames the driver or the chip counted as dropped or broken */
+static unsigned long ax_lost(struct net_device *dev)
+{
+	return dev->stats.rx_errors + dev->stats.rx_dropped +
+	       dev->stats.rx_missed_errors + dev->stats.tx_errors +
+	       dev->stats.tx_dropped;
+}
+
+/*
+ * Every run of a recovery path, injected or not, is timed from
+ * ax_recover_begin() to ax_recover_end(), and the growth of the loss
+ * counters in between is charged to it. The time is that of the
+ * recovery itself; how long the fault took to be noticed is not known.
+ */
+static void ax_recover_begin(struct net_device *dev, int fault)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	ax->rec_t0[fault] = ktime_get_ns();
+	ax->rec_lost0[fault] = ax_lost(dev);
+}
+
+static void ax_recover_end(struct net_device *dev, int fault)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+	u64 ns = ktime_get_ns() - ax->rec_t0[fault];
+
+	ax->rec_n[fault]++;
+	ax->rec_ns[fault] += ns;
+	if (ns > ax->rec_max[fault])
+		ax->rec_max[fault] = ns;
+	ax->rec_lost[fault] += ax_lost(dev) - ax->rec_lost0[fault];
+}
+
+#ifdef CONFIG_AX88796_TRACE
+/*
+ * Register trace. One record per 8390 register access, per FIFO burst
+ * and per 4 bytes of its first trace_data, and one at each entry to and
+ * exit from the driver core, oldest overwritten first unless trace is 2;
+ * read it back through debugfs with tracing off. Meant for capturing a
+ * misbehaving board, not for speed.
+ */
+/* the next record, if there is room for @n: a burst is kept whole */
+static struct ax_trace_rec *ax_trace_next(struct ax_device *ax, int kind,
+					  unsigned int n)
+{
+	struct ax_trace_rec *rec;
+
+	if (trace == 2 && ax->trace_head + n > trace_entries)
+		return NULL;
+	rec = &ax->trace[ax->trace_head++ % trace_entries];
+	rec->ns = ktime_get_ns();
+	rec->kind = kind;
+	return rec;
+}
+
+static void ax_trace(struct ei_device *ei_local, int kind,
+		     unsigned int off, unsigned int val)
+{
+	struct ax_device *ax = (struct ax_device *)(ei_local + 1);
+	struct ax_trace_rec *rec;
+	unsigned long flags;
+
+	if (!trace || !ax->trace)
+		return;
+
+	spin_lock_irqsave(&ax->trace_lock, flags);
+	rec = ax_trace_next(ax, kind, 1);
+	if (rec) {
+		rec->off = off;
+		rec->val = val;
 	}
-	if(count & 1)
-	{
-		*(uint8_t*)dst = ei_inb(ei_local->mem + NE_DATAPORT);
+	spin_unlock_irqrestore(&ax->trace_lock, flags);
+}
+
+/* a FIFO burst of @n bytes, a multiple of 4, and its leading bytes */
+static void ax_trace_data(struct ei_device *ei_local, int kind,
+			  const void *buf, unsigned int n)
+{
+	struct ax_device *ax = (struct ax_device *)(ei_local + 1);
+	unsigned int i, len = min(n, trace_data) & ~3;
+	struct ax_trace_rec *rec;
+	unsigned long flags;
+
+	if (!trace || !ax->trace || !n)
+		return;
+
+	spin_lock_irqsave(&ax->trace_lock, flags);
+	rec = ax_trace_next(ax, kind, 1 + len / 4);
+	if (rec) {
+		rec->off = 0;
+		rec->val = n;
+		for (i = 0; i < len; i += 4) {
+			rec = ax_trace_next(ax, AX_TR_DATA, 1);
+			rec->off = i;
+			memcpy(rec->data, buf + i, 4);
+		}
 	}
+	spin_unlock_irqrestore(&ax->trace_lock, flags);
+}
+#endif
+
+static void ax_bus_add(struct net_device *dev, u64 t0, unsigned int bytes)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	if (!t0)
+		return;
+
+	ax->bus_ns += ktime_get_ns() - t0;
+	ax->bus_bytes += bytes;
 }
 
 /*
@@ -253,6 +674,7 @@ static void ax_reset_8390(struct net_device *dev)
 	struct ei_device *ei_local = netdev_priv(dev);
 	unsigned long reset_start_time = jiffies;
 	void __iomem *addr = (void __iomem *)dev->base_addr;
+	bool stuck = ax_fail(dev, EI_FAULT_RESET);
 
 	if (ei_debug > 1)
 		netdev_dbg(dev, "resetting the 8390 t=%ld\n", jiffies);
@@ -263,7 +685,7 @@ static void ax_reset_8390(struct net_device *dev)
 	ei_local->dmaing = 0;
 
 	/* This check _should_not_ be necessary, omit eventually. */
-	while ((ei_inb(addr + EN0_ISR) & ENISR_RESET) == 0) {
+	while (stuck || (ei_inb(addr + EN0_ISR) & ENISR_RESET) == 0) {
 		if (jiffies - reset_start_time > 2 * HZ / 100) {
 			netdev_warn(dev, "%s: did not complete.\n", __func__);
 			break;
@@ -274,128 +696,190 @@ static void ax_reset_8390(struct net_device *dev)
 }
 
 
-static void ax_get_8390_hdr(struct net_device *dev, struct e8390_pkt_hdr *hdr,
-			    int ring_page)
+/*
+ * Remote DMA channel
+ *
+ * The AX88796 has a single remote DMA engine, shared by the Rx header and
+ * payload reads, Tx uploads and the PROM read. Every transfer is described
+ * by an ax_dma_job and goes through ax_dma_submit(). Callers hold
+ * page_lock, so jobs never overlap; the only nesting is the Rx service
+ * ax_dma_yield() runs between two chunks of a Tx upload, while the
+ * channel is idle.
+ */
+struct ax_dma_job {
+	unsigned char op;		/* enum ax_dma_op */
+	unsigned short addr;		/* card address */
+	unsigned short count;
+	union {
+		void *in;
+		const void *out;
+	} buf;
+};
+
+static void ax_dma_setup(struct ei_device *ei_local, unsigned int addr,
+			 unsigned int count)
 {
-	struct ei_device *ei_local = netdev_priv(dev);
 	void __iomem *nic_base = ei_local->mem;
 
-	/* This *shouldn't* happen. If it does, it's the last thing you'll see */
-	if (ei_local->dmaing) {
-		netdev_err(dev, "DMAing conflict in %s "
-			"[DMAstat:%d][irqlock:%d].\n",
-			__func__,
-			ei_local->dmaing, ei_local->irqlock);
-		return;
-	}
-
-	ei_local->dmaing |= 0x01;
-	ei_outb(E8390_NODMA + E8390_PAGE0 + E8390_START, nic_base + NE_CMD);
-	ei_outb(sizeof(struct e8390_pkt_hdr), nic_base + EN0_RCNTLO);
-	ei_outb(0, nic_base + EN0_RCNTHI);
-	ei_outb(0, nic_base + EN0_RSARLO);		/* On page boundary */
-	ei_outb(ring_page, nic_base + EN0_RSARHI);
-	ei_outb(E8390_RREAD+E8390_START, nic_base + NE_CMD);
-
-	xs100_read(dev, hdr, sizeof(struct e8390_pkt_hdr));
-
-	ei_outb(ENISR_RDC, nic_base + EN0_ISR);	/* Ack intr. */
-	ei_local->dmaing &= ~0x01;
-
-	le16_to_cpus(&hdr->count);
+	ei_outb(count & 0xff, nic_base + EN0_RCNTLO);
+	ei_outb(count >> 8, nic_base + EN0_RCNTHI);
+	ei_outb(addr & 0xff, nic_base + EN0_RSARLO);
+	ei_outb(addr >> 8, nic_base + EN0_RSARHI);
 }
 
-
 /*
- * Block input and output, similar to the Crynwr packet driver. If
- * you are porting to a new ethercard, look at the packet driver
- * source for hints. The NEx000 doesn't share the on-board packet
- * memory -- you have to put the packet out through the "remote DMA"
- * dataport using ei_outb.
+ * Between two Tx chunks the channel is idle, so with the card claimed by
+ * the Tx worker the Rx ring can be serviced if it overran or is above its
+ * watermark. An overrun gets the full ei_rx_overrun() stop and restart;
+ * that only clears RBCR, and the next chunk programs the channel afresh.
+ * The Rx reads are jobs of their own and must not see ours as running.
  */
-static void ax_block_input(struct net_device *dev, int count,
-			   struct sk_buff *skb, int ring_offset)
+static void ax_dma_yield(struct net_device *dev)
 {
 	struct ei_device *ei_local = netdev_priv(dev);
-	void __iomem *nic_base = ei_local->mem;
-	char *buf = skb->data;
-
-	if (ei_local->dmaing) {
-		netdev_err(dev,
-			"DMAing conflict in %s "
-			"[DMAstat:%d][irqlock:%d].\n",
-			__func__,
-			ei_local->dmaing, ei_local->irqlock);
+	struct ax_device *ax = to_ax_dev(dev);
+
+	if (!ei_local->irqlock || ax->testing)
 		return;
-	}
 
-	ei_local->dmaing |= 0x01;
+	ei_local->dmaing = 0;
+	if (ei_tx_make_room(dev))
+		ax->dma_tx_yield++;
+	ei_local->dmaing = 1;
+}
 
-	ei_outb(E8390_NODMA+E8390_PAGE0+E8390_START, nic_base + NE_CMD);
-	ei_outb(count & 0xff, nic_base + EN0_RCNTLO);
-	ei_outb(count >> 8, nic_base + EN0_RCNTHI);
-	ei_outb(ring_offset & 0xff, nic_base + EN0_RSARLO);
-	ei_outb(ring_offset >> 8, nic_base + EN0_RSARHI);
-	ei_outb(E8390_RREAD+E8390_START, nic_base + NE_CMD);
-
-	xs100_read(dev, buf, count);
-
-	ei_local->dmaing &= ~1;
-}
-
-static void ax_block_output(struct net_device *dev, int count,
-			    const unsigned char *buf, const int start_page)
+/* returns -ETIMEDOUT if a Tx upload had to reset the card */
+static int ax_dma_run(struct net_device *dev, struct ax_dma_job *job)
 {
 	struct ei_device *ei_local = netdev_priv(dev);
 	void __iomem *nic_base = ei_local->mem;
+	const unsigned char *buf = job->buf.out;
+	unsigned int chunk = dma_chunk & ~63;
+	unsigned int done, len;
 	unsigned long dma_start;
+	bool rdc_lost;
+	u64 t0, t1;
 
-	/*
-	 * Round the count up for word writes. Do we need to do this?
-	 * What effect will an odd byte count have on the 8390?  I
-	 * should check someday.
-	 */
-	if (ei_local->word16 && (count & 0x01))
-		count++;
+	ei_outb(E8390_NODMA + E8390_PAGE0 + E8390_START, nic_base + NE_CMD);
 
-	/* This *shouldn't* happen. If it does, it's the last thing you'll see */
-	if (ei_local->dmaing) {
-		netdev_err(dev, "DMAing conflict in %s."
-			"[DMAstat:%d][irqlock:%d]\n",
-			__func__,
-		       ei_local->dmaing, ei_local->irqlock);
-		return;
+	if (job->op != AX_DMA_TX) {
+		t0 = ax_stage_clock();
+		ax_dma_setup(ei_local, job->addr, job->count);
+		ei_outb(E8390_RREAD+E8390_START, nic_base + NE_CMD);
+		ax_bus(ei_local)->read_data(dev, job->buf.in, job->count);
+		if (job->op != AX_DMA_RX_DATA)
+			ei_outb(ENISR_RDC, nic_base + EN0_ISR);	/* Ack intr. */
+		ax_bus_add(dev, t0, job->count);
+		return 0;
 	}
 
-	ei_local->dmaing |= 0x01;
-	/* We should already be in page 0, but to be safe... */
-	ei_outb(E8390_PAGE0+E8390_START+E8390_NODMA, nic_base + NE_CMD);
+	if (!chunk)
+		chunk = job->count;
+
+	for (done = 0; done < job->count; done += len) {
+		if (done)
+			ax_dma_yield(dev);
+
+		/* resume where the last chunk stopped */
+		len = min(job->count - done, chunk);
+		t0 = ax_stage_clock();
+		ei_outb(ENISR_RDC, nic_base + EN0_ISR);
+		ax_dma_setup(ei_local, job->addr + done, len);
+		ei_outb(E8390_RWRITE+E8390_START, nic_base + NE_CMD);
+		ax_bus(ei_local)->write_data(dev, buf + done, len);
+
+		t1 = ax_stage_clock();
+		dma_start = jiffies;
+		rdc_lost = ax_fail(dev, EI_FAULT_RDC);
+
+		while ((ei_inb(nic_base + EN0_ISR) & ENISR_RDC) == 0 || rdc_lost) {
+			if (jiffies - dma_start > 2 * HZ / 100 || rdc_lost) {	/* 20ms */
+				netdev_warn(dev, "timeout waiting for Tx RDC.\n");
+				ax_recover_begin(dev, EI_FAULT_RDC);
+				ax_recover_begin(dev, EI_FAULT_RESET);
+				ax_reset_8390(dev);
+				ax_NS8390_init(dev, 1);
+				ax_recover_end(dev, EI_FAULT_RESET);
+				ax_recover_end(dev, EI_FAULT_RDC);
+				return -ETIMEDOUT;
+			}
+		}
+		ax_stage_add(dev, EI_STAGE_RDC, t1);
+		ax_bus_add(dev, t0, len);
+	}
 
-	ei_outb(ENISR_RDC, nic_base + EN0_ISR);
+	ei_outb(ENISR_RDC, nic_base + EN0_ISR);	/* Ack intr. */
+	return 0;
+}
 
-	/* Now the normal output. */
-	ei_outb(count & 0xff, nic_base + EN0_RCNTLO);
-	ei_outb(count >> 8, nic_base + EN0_RCNTHI);
-	ei_outb(0x00, nic_base + EN0_RSARLO);
-	ei_outb(start_page, nic_base + EN0_RSARHI);
+static int ax_dma_submit(struct net_device *dev, struct ax_dma_job *job)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	int ret;
 
-	ei_outb(E8390_RWRITE+E8390_START, nic_base + NE_CMD);
+	WARN_ON_ONCE(ei_local->dmaing);
+	ei_local->dmaing = 1;
+	ret = ax_dma_run(dev, job);
+	ei_local->dmaing = 0;
+	return ret;
+}
 
-	xs100_write(dev, buf, count);
+static void ax_get_8390_hdr(struct net_device *dev, struct e8390_pkt_hdr *hdr,
+			    int ring_page)
+{
+	struct ax_dma_job job = {
+		.op	= AX_DMA_RX_HDR,
+		.addr	= ring_page << 8,		/* On page boundary */
+		.count	= sizeof(struct e8390_pkt_hdr),
+		.buf.in	= hdr,
+	};
 
-	dma_start = jiffies;
+	ax_dma_submit(dev, &job);
 
-	while ((ei_inb(nic_base + EN0_ISR) & ENISR_RDC) == 0) {
-		if (jiffies - dma_start > 2 * HZ / 100) {		/* 20ms */
-			netdev_warn(dev, "timeout waiting for Tx RDC.\n");
-			ax_reset_8390(dev);
-			ax_NS8390_init(dev, 1);
-			break;
-		}
-	}
+	le16_to_cpus(&hdr->count);
+}
 
-	ei_outb(ENISR_RDC, nic_base + EN0_ISR);	/* Ack intr. */
-	ei_local->dmaing &= ~0x01;
+
+/*
+ * Block input and output, similar to the Crynwr packet driver. If
+ * you are porting to a new ethercard, look at the packet driver
+ * source for hints. The NEx000 doesn't share the on-board packet
+ * memory -- you have to put the packet out through the "remote DMA"
+ * dataport using ei_outb.
+ */
+static void ax_block_input(struct net_device *dev, int count,
+			   struct sk_buff *skb, int ring_offset)
+{
+	struct ax_dma_job job = {
+		.op	= AX_DMA_RX_DATA,
+		.addr	= ring_offset,
+		.count	= count,
+		.buf.in	= skb->data,
+	};
+
+	ax_dma_submit(dev, &job);
+}
+
+static int ax_block_output(struct net_device *dev, int count,
+			   const unsigned char *buf, const int start_page)
+{
+	struct ei_device *ei_local __maybe_unused = netdev_priv(dev);
+	struct ax_dma_job job = {
+		.op	= AX_DMA_TX,
+		.addr	= start_page << 8,
+		.buf.out = buf,
+	};
+
+	/*
+	 * Round the count up for word writes. Do we need to do this?
+	 * What effect will an odd byte count have on the 8390?  I
+	 * should check someday.
+	 */
+	if (ei_word16(ei_local) && (count & 0x01))
+		count++;
+
+	job.count = count;
+	return ax_dma_submit(dev, &job);
 }
 
 /* definitions for accessing MII/EEPROM interface */
@@ -410,6 +894,49 @@ static void ax_block_output(struct net_device *dev, int count,
 #define AX_MEMR_EEO		BIT(6)
 #define AX_MEMR_EECLK		BIT(7)
 
+/* general purpose input, mirrors the internal PHY's link state */
+#define AX_GPI			EI_SHIFT(0x17)
+#define AX_GPI_LINK		BIT(0)
+#define AX_GPI_FDX		BIT(1)
+#define AX_GPI_SPD100		BIT(2)
+#define AX_GPI_MASK		(AX_GPI_LINK | AX_GPI_FDX | AX_GPI_SPD100)
+
+#define AX_LINK_POLL		HZ		/* GPI sample interval */
+#define AX_LINK_RESYNC		(60 * HZ)	/* full MDIO check regardless */
+
+/*
+ * ax_set_duplex
+ *
+ * Apply the negotiated duplex to the MAC. The AX88796 takes its speed
+ * from the PHY, so only TXCR.FDU needs programming; the value is also
+ * kept in txcr_base so that a later NS8390_init() restores it.
+ */
+static void ax_set_duplex(struct net_device *dev, int duplex)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ei_local->page_lock, flags);
+	ei_local->txcr_base = (duplex == DUPLEX_FULL) ? AX_TXCR_FDU : 0;
+	ei_outb(E8390_TXCONFIG, ei_local->mem + EN0_TXCR);
+	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+}
+
+static void ax_tx_status(struct net_device *dev, unsigned char txsr)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+	int fd = (ax->duplex == DUPLEX_FULL);
+
+	if (txsr & ENTSR_PTX)
+		ax->tx_frames[fd]++;
+	if (txsr & ENTSR_COL)
+		ax->tx_collisions[fd]++;
+	if (txsr & ENTSR_ABT)
+		ax->tx_aborts[fd]++;
+	if (txsr & ENTSR_OWC)
+		ax->tx_late_collisions[fd]++;
+}
+
 static void ax_handle_link_change(struct net_device *dev)
 {
 	struct ax_device  *ax = to_ax_dev(dev);
@@ -421,6 +948,7 @@ static void ax_handle_link_change(struct net_device *dev)
 
 		ax->speed = phy_dev->speed;
 		ax->duplex = phy_dev->duplex;
+		ax_set_duplex(dev, ax->duplex);
 		status_change = 1;
 	}
 
@@ -438,6 +966,35 @@ static void ax_handle_link_change(struct net_device *dev)
 		phy_print_status(phy_dev);
 }
 
+/*
+ * The PHY is not polled by phylib (PHY_IGNORE_INTERRUPT): a bitbanged
+ * MDIO status read costs a few hundred bus cycles. Instead the GPI
+ * register, which follows the PHY's link, speed and duplex pins, is
+ * sampled with a single read, and phylib only gets to talk MDIO when
+ * that changes or when the slow resync interval expires.
+ */
+static void ax_link_work(struct work_struct *work)
+{
+	struct ax_device *ax = container_of(to_delayed_work(work),
+					    struct ax_device, link_work);
+	struct net_device *dev = ax_to_ei(ax)->dev;
+	struct ei_device *ei_local = netdev_priv(dev);
+	unsigned long flags;
+	u8 gpi;
+
+	spin_lock_irqsave(&ei_local->page_lock, flags);
+	gpi = ei_inb(ei_local->mem + AX_GPI) & AX_GPI_MASK;
+	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+
+	if (gpi != ax->gpi || time_after(jiffies, ax->link_resync)) {
+		ax->gpi = gpi;
+		ax->link_resync = jiffies + AX_LINK_RESYNC;
+		phy_mac_interrupt(ax->phy_dev, !!(gpi & AX_GPI_LINK));
+	}
+
+	schedule_delayed_work(&ax->link_work, AX_LINK_POLL);
+}
+
 static int ax_mii_probe(struct net_device *dev)
 {
 	struct ax_device  *ax = to_ax_dev(dev);
@@ -488,40 +1045,99 @@ static void ax_phy_switch(struct net_device *dev, int on)
 static irqreturn_t wrap_ax_ei_interrupt(int irq, void *dev_id)
 {
 	struct net_device *dev = dev_id;
-	struct ax_device *ax = to_ax_dev(dev);
+	struct ei_device *ei_local = netdev_priv(dev);
+	irqreturn_t ret = IRQ_NONE;
+
+	ei_prof_begin(dev, EI_PROF_IRQ);
 
 	/* handle shared IRQ nicely */
-	if(z_readw(ax->xs100irqstatusreg) & 0x8000)
-		return ax_ei_interrupt(irq, dev_id);
+	if (!ax_bus(ei_local)->irq_pending ||
+	    ax_bus(ei_local)->irq_pending(dev)) {
+		/* stamp Rx frames when the card asserted, not when read out */
+		if (rx_timestamp)
+			ei_local->rx_stamp = ktime_get_real();
+		ax_trace_enter(ei_local, AX_CTX_IRQ);
+		ret = ax_ei_interrupt(irq, dev_id);
+		ax_trace_leave(ei_local, AX_CTX_IRQ);
+	}
+
+	ei_prof_end(dev, EI_PROF_IRQ);
+	return ret;
+}
+
+static int ax_request_irq(struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	if (ax_bus(ei_local)->request_irq)
+		return ax_bus(ei_local)->request_irq(dev);
+
+	return request_irq(dev->irq, wrap_ax_ei_interrupt,
+			   to_ax_dev(dev)->irqflags, dev->name, dev);
+}
+
+static void ax_free_irq(struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	if (ax_bus(ei_local)->free_irq)
+		ax_bus(ei_local)->free_irq(dev);
 	else
-		return IRQ_NONE;
+		free_irq(dev->irq, dev);
 }
 
 static int ax_open(struct net_device *dev)
 {
+	struct ei_device *ei_local = netdev_priv(dev);
 	struct ax_device *ax = to_ax_dev(dev);
 	int ret;
 
 	netdev_dbg(dev, "open\n");
 
-	ret = ax_mii_init(dev);
-	if (ret)
-		goto failed_request_irq;
+	if (!ax_bus(ei_local)->has_mii) {
+		/* plain NE2000 clone: no PHY to manage */
+		ret = ax_request_irq(dev);
+		if (ret)
+			return ret;
+		netif_carrier_on(dev);
+		ax_trace_enter(ei_local, AX_CTX_OPEN);
+		ret = ax_ei_open(dev);
+		ax_trace_leave(ei_local, AX_CTX_OPEN);
+		if (ret)
+			ax_free_irq(dev);
+		else
+			ax->running = 1;
+		return ret;
+	}
+
+	/* the MII bus and PHY are brought up in the background after probe */
+	flush_work(&ax->mii_work);
+	if (!ax->mii_bus)
+		return -ENODEV;
+	if (!ax->phy_dev) {
+		/* the PHY may have been slow to come out of power down */
+		ret = ax_mii_probe(dev);
+		if (ret)
+			return ret;
+	}
 
-	ret = request_irq(dev->irq, wrap_ax_ei_interrupt, ax->irqflags,
-			  dev->name, dev);
+	ret = ax_request_irq(dev);
 	if (ret)
-		goto failed_request_irq;
+		return ret;
 
 	/* turn the phy on (if turned off) */
 	ax_phy_switch(dev, 1);
 
-	ret = ax_mii_probe(dev);
-	if (ret)
-		goto failed_mii_probe;
+	/* resumes without renegotiating if the link stayed up */
 	phy_start(ax->phy_dev);
 
+	/* force a first phylib pass on the next sample */
+	ax->link_resync = jiffies;
+	schedule_delayed_work(&ax->link_work, 0);
+
+	ax_trace_enter(ei_local, AX_CTX_OPEN);
 	ret = ax_ei_open(dev);
+	ax_trace_leave(ei_local, AX_CTX_OPEN);
 	if (ret)
 		goto failed_ax_ei_open;
 
@@ -530,16 +1146,17 @@ static int ax_open(struct net_device *dev)
 	return 0;
 
  failed_ax_ei_open:
-	phy_disconnect(ax->phy_dev);
- failed_mii_probe:
-	ax_phy_switch(dev, 0);
-	free_irq(dev->irq, dev);
- failed_request_irq:
+	cancel_delayed_work_sync(&ax->link_work);
+	phy_stop(ax->phy_dev);
+	if (!keep_phy_powered)
+		ax_phy_switch(dev, 0);
+	ax_free_irq(dev);
 	return ret;
 }
 
 static int ax_close(struct net_device *dev)
 {
+	struct ei_device *ei_local = netdev_priv(dev);
 	struct ax_device *ax = to_ax_dev(dev);
 
 	netdev_dbg(dev, "close\n");
@@ -547,17 +1164,23 @@ static int ax_close(struct net_device *dev)
 	ax->running = 0;
 	wmb();
 
+	ax_trace_enter(ei_local, AX_CTX_CLOSE);
 	ax_ei_close(dev);
+	ax_trace_leave(ei_local, AX_CTX_CLOSE);
+
+	if (!ax_bus(ei_local)->has_mii) {
+		ax_free_irq(dev);
+		return 0;
+	}
 
-	/* turn the phy off */
-	ax_phy_switch(dev, 0);
-	phy_disconnect(ax->phy_dev);
+	cancel_delayed_work_sync(&ax->link_work);
+	phy_stop(ax->phy_dev);
 
-	free_irq(dev->irq, dev);
+	/* turn the phy off, unless asked to keep the link for the next open */
+	if (!keep_phy_powered)
+		ax_phy_switch(dev, 0);
 
-	mdiobus_unregister(ax->mii_bus);
-	kfree(ax->mii_bus->irq);
-	free_mdio_bitbang(ax->mii_bus);
+	ax_free_irq(dev);
 	return 0;
 }
 
@@ -580,11 +1203,298 @@ static int ax_ioctl(struct net_device *dev, struct ifreq *req, int cmd)
 static void ax_get_drvinfo(struct net_device *dev,
 			   struct ethtool_drvinfo *info)
 {
-	struct zorro_dev *zdev = to_zorro_dev(dev->dev.parent);
-
 	strlcpy(info->driver, DRV_NAME, sizeof(info->driver));
 	strlcpy(info->version, DRV_VERSION, sizeof(info->version));
-	strlcpy(info->bus_info, zdev->name, sizeof(info->bus_info));
+	strlcpy(info->bus_info, dev_name(dev->dev.parent),
+		sizeof(info->bus_info));
+}
+
+/*
+ * Counters exported through ethtool -S. Offsets are from netdev_priv(),
+ * i.e. the ei_device that ax_device follows.
+ */
+#define EI_STAT(m)	offsetof(struct ei_device, m)
+#define AX_STAT(m)	(sizeof(struct ei_device) + offsetof(struct ax_device, m))
+
+static const struct {
+	char name[ETH_GSTRING_LEN];
+	size_t offset;
+} ax_stats[] = {
+	{ "irq_spurious", AX_STAT(irq_spurious) },
+	{ "tx_frames_hd", AX_STAT(tx_frames[0]) },
+	{ "tx_collisions_hd", AX_STAT(tx_collisions[0]) },
+	{ "tx_aborts_hd", AX_STAT(tx_aborts[0]) },
+	{ "tx_late_collisions_hd", AX_STAT(tx_late_collisions[0]) },
+	{ "tx_frames_fd", AX_STAT(tx_frames[1]) },
+	{ "tx_collisions_fd", AX_STAT(tx_collisions[1]) },
+	{ "tx_aborts_fd", AX_STAT(tx_aborts[1]) },
+	{ "tx_late_collisions_fd", AX_STAT(tx_late_collisions[1]) },
+	{ "tx_timeout_retry", EI_STAT(tx_recover[EI_TXREC_RETRY]) },
+	{ "tx_timeout_abort", EI_STAT(tx_recover[EI_TXREC_ABORT]) },
+	{ "tx_timeout_reset", EI_STAT(tx_recover[EI_TXREC_RESET]) },
+	{ "rx_drain_before_tx", EI_STAT(rx_drain_tx) },
+	{ "dma_tx_yield", AX_STAT(dma_tx_yield) },
+	{ "rx_ring_fill_0/8", EI_STAT(rx_fill[0]) },
+	{ "rx_ring_fill_1/8", EI_STAT(rx_fill[1]) },
+	{ "rx_ring_fill_2/8", EI_STAT(rx_fill[2]) },
+	{ "rx_ring_fill_3/8", EI_STAT(rx_fill[3]) },
+	{ "rx_ring_fill_4/8", EI_STAT(rx_fill[4]) },
+	{ "rx_ring_fill_5/8", EI_STAT(rx_fill[5]) },
+	{ "rx_ring_fill_6/8", EI_STAT(rx_fill[6]) },
+	{ "rx_ring_fill_7/8", EI_STAT(rx_fill[7]) },
+};
+
+/*
+ * ethtool -t: offline loopback test. With the card claimed, frames are
+ * uploaded, sent with EN0_TXCR in internal loopback and read back from
+ * the Rx ring by polling, then compared. Upload to read back is one
+ * round trip. Reports pass/fail, frames/s, kB/s and the median and p99
+ * round trip.
+ */
+#define AX_TEST_FRAMES	128
+#define AX_TEST_LEN	ETH_FRAME_LEN
+#define AX_TEST_PROTO	0x88b5		/* IEEE 802 local experimental */
+
+enum {
+	AX_TEST_LOOPBACK,
+	AX_TEST_FPS,
+	AX_TEST_KBPS,
+	AX_TEST_RTT_MED,
+	AX_TEST_RTT_P99,
+	AX_TEST_NR
+};
+
+static const char ax_test_names[AX_TEST_NR][ETH_GSTRING_LEN] = {
+	[AX_TEST_LOOPBACK]	= "loopback (offline)",
+	[AX_TEST_FPS]		= "loopback frames/s",
+	[AX_TEST_KBPS]		= "loopback kB/s",
+	[AX_TEST_RTT_MED]	= "loopback rtt median us",
+	[AX_TEST_RTT_P99]	= "loopback rtt p99 us",
+};
+
+struct ax_test {
+	u8 tx[AX_TEST_LEN];
+	u64 rtt[AX_TEST_FRAMES];
+};
+
+static int ax_test_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Empty the Rx ring before the loopback, so the first frame the test
+ * reads back is its own. ei_receive() stops after a handful of frames.
+ */
+static int ax_test_drain(struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *nic_base = ei_local->mem;
+	unsigned char curpag;
+	int i;
+
+	if (ei_inb(nic_base + EN0_ISR) & ENISR_OVER)
+		ei_rx_overrun(dev);
+
+	for (i = 0; i < ei_local->stop_page - ei_local->rx_start_page; i++) {
+		ei_outb(E8390_NODMA + E8390_PAGE1, nic_base + E8390_CMD);
+		curpag = ei_inb(nic_base + EN1_CURPAG);
+		ei_outb(E8390_NODMA + E8390_PAGE0, nic_base + E8390_CMD);
+		if (!ei_rx_fill(ei_local, curpag))
+			return 0;
+		ei_receive(dev);
+	}
+	return -EBUSY;
+}
+
+/* one frame out and back; card claimed, transmitter in loopback */
+static int ax_test_frame(struct net_device *dev, struct ax_test *t,
+			 struct sk_buff *skb, int n)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *nic_base = ei_local->mem;
+	struct e8390_pkt_hdr hdr;
+	unsigned long timeout;
+	unsigned char isr = 0;
+	int i, next;
+	u64 t0;
+
+	for (i = ETH_HLEN; i < AX_TEST_LEN; i++)
+		t->tx[i] = n + i;
+
+	t0 = ktime_get_ns();
+	if (ax_block_output(dev, AX_TEST_LEN, t->tx, ei_local->tx_start_page))
+		return -EIO;
+	NS8390_trigger_send(dev, AX_TEST_LEN, ei_local->tx_start_page);
+
+	timeout = jiffies + HZ / 10;
+	do {
+		isr |= ei_inb(nic_base + EN0_ISR);
+		if ((isr & (ENISR_TX | ENISR_TX_ERR)) &&
+		    (isr & (ENISR_RX | ENISR_RX_ERR)))
+			break;
+	} while (time_before(jiffies, timeout));
+	ei_outb(isr, nic_base + EN0_ISR);
+
+	if (!(isr & ENISR_TX) || !(isr & ENISR_RX))
+		return -ETIMEDOUT;
+
+	ax_get_8390_hdr(dev, &hdr, ei_local->current_page);
+	next = hdr.next;
+	if ((hdr.status & 0x0f) != ENRSR_RXOK ||
+	    hdr.count < sizeof(hdr) + AX_TEST_LEN ||
+	    next < ei_local->rx_start_page || next >= ei_local->stop_page)
+		return -EIO;
+
+	ax_block_input(dev, AX_TEST_LEN, skb,
+		       (ei_local->current_page << 8) + sizeof(hdr));
+	t->rtt[n] = ktime_get_ns() - t0;
+
+	ei_local->current_page = next;
+	ei_outb(next == ei_local->rx_start_page ?
+		ei_local->stop_page - 1 : next - 1, nic_base + EN0_BOUNDARY);
+
+	return memcmp(skb->data, t->tx, AX_TEST_LEN) ? -EIO : 0;
+}
+
+static void ax_self_test(struct net_device *dev, struct ethtool_test *test,
+			 u64 *data)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *nic_base = ei_local->mem;
+	struct ax_device *ax = to_ax_dev(dev);
+	struct sk_buff *skb = NULL;
+	struct ax_test *t = NULL;
+	unsigned long flags;
+	u64 total = 0;
+	int i, ret;
+
+	memset(data, 0, AX_TEST_NR * sizeof(*data));
+	if (!(test->flags & ETH_TEST_FL_OFFLINE))
+		return;
+
+	ret = -ENETDOWN;
+	if (!netif_running(dev))
+		goto out;
+
+	ret = -ENOMEM;
+	t = kmalloc(sizeof(*t), GFP_KERNEL);
+	skb = netdev_alloc_skb(dev, AX_TEST_LEN);
+	if (!t || !skb)
+		goto out;
+
+	memcpy(t->tx, dev->dev_addr, ETH_ALEN);
+	memcpy(t->tx + ETH_ALEN, dev->dev_addr, ETH_ALEN);
+	*(__be16 *)(t->tx + 2 * ETH_ALEN) = htons(AX_TEST_PROTO);
+
+	/* keep the Tx worker off the card and let the transmitter drain */
+	netif_tx_disable(dev);
+	flush_work(&ei_local->tx_work);
+	for (i = 0; i < 10 && ei_local->txing; i++)
+		msleep(10);
+
+	/* ei_receive() may hand frames already in the ring to netif_rx() */
+	local_bh_disable();
+	ei_tx_claim(dev, &flags);
+
+	ret = -EBUSY;
+	if (!ei_local->txing && !ei_local->tx1 && !ei_local->tx2)
+		ret = ax_test_drain(dev);
+	if (!ret) {
+		ei_outb(E8390_TXOFF, nic_base + EN0_TXCR);
+		ax->testing = 1;
+	}
+	ei_tx_release(dev, &flags);
+	local_bh_enable();
+
+	if (!ax->testing)
+		goto wake;
+
+	/*
+	 * Claim the card per frame, so the stats and the rest of the driver
+	 * are only ever locked out for one round trip, and give up on the
+	 * first frame that does not come back.
+	 */
+	for (i = 0; i < AX_TEST_FRAMES; i++) {
+		ei_tx_claim(dev, &flags);
+		ret = ax_test_frame(dev, t, skb, i);
+		ei_tx_release(dev, &flags);
+		if (ret)
+			break;
+		total += t->rtt[i];
+		/* the queues are stopped, keep the watchdog off the test */
+		dev->trans_start = jiffies;
+	}
+
+	ei_tx_claim(dev, &flags);
+	ei_outb(E8390_TXCONFIG, nic_base + EN0_TXCR);
+	ax->testing = 0;
+	ei_tx_release(dev, &flags);
+
+ wake:
+	netif_tx_wake_all_queues(dev);
+	queue_work(system_highpri_wq, &ei_local->tx_work);
+
+	if (!ret) {
+		sort(t->rtt, AX_TEST_FRAMES, sizeof(*t->rtt), ax_test_cmp, NULL);
+		data[AX_TEST_FPS] = div64_u64((u64)AX_TEST_FRAMES * NSEC_PER_SEC,
+					      total);
+		data[AX_TEST_KBPS] = div64_u64((u64)AX_TEST_FRAMES * AX_TEST_LEN *
+					       (NSEC_PER_SEC / 1000), total);
+		data[AX_TEST_RTT_MED] = div_u64(t->rtt[AX_TEST_FRAMES / 2],
+						NSEC_PER_USEC);
+		data[AX_TEST_RTT_P99] = div_u64(t->rtt[AX_TEST_FRAMES * 99 / 100],
+						NSEC_PER_USEC);
+	}
+
+ out:
+	if (ret) {
+		netdev_info(dev, "loopback test failed (%d)\n", ret);
+		test->flags |= ETH_TEST_FL_FAILED;
+		data[AX_TEST_LOOPBACK] = 1;
+	}
+	kfree_skb(skb);
+	kfree(t);
+}
+
+static int ax_get_sset_count(struct net_device *dev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(ax_stats);
+	case ETH_SS_TEST:
+		return AX_TEST_NR;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void ax_get_strings(struct net_device *dev, u32 sset, u8 *data)
+{
+	int i;
+
+	switch (sset) {
+	case ETH_SS_STATS:
+		for (i = 0; i < ARRAY_SIZE(ax_stats); i++)
+			memcpy(data + i * ETH_GSTRING_LEN, ax_stats[i].name,
+			       ETH_GSTRING_LEN);
+		break;
+	case ETH_SS_TEST:
+		memcpy(data, ax_test_names, sizeof(ax_test_names));
+		break;
+	}
+}
+
+static void ax_get_ethtool_stats(struct net_device *dev,
+				 struct ethtool_stats *stats, u64 *data)
+{
+	char *priv = netdev_priv(dev);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ax_stats); i++)
+		data[i] = *(unsigned long *)(priv + ax_stats[i].offset);
 }
 
 static int ax_get_settings(struct net_device *dev, struct ethtool_cmd *cmd)
@@ -615,6 +1525,10 @@ static const struct ethtool_ops ax_ethtool_ops = {
 	.set_settings		= ax_set_settings,
 	.get_link		= ethtool_op_get_link,
 	.get_ts_info		= ethtool_op_get_ts_info,
+	.get_sset_count		= ax_get_sset_count,
+	.get_strings		= ax_get_strings,
+	.get_ethtool_stats	= ax_get_ethtool_stats,
+	.self_test		= ax_self_test,
 };
 
 #ifdef CONFIG_AX88796_93CX6
@@ -648,13 +1562,39 @@ static void ax_eeprom_register_write(struct eeprom_93cx6 *eeprom)
 }
 #endif
 
+/* the remaining driver core entry points, marked in the register trace */
+static netdev_tx_t ax_start_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	ax_trace_xmit((struct ei_device *)netdev_priv(dev), skb);
+	return ax_ei_start_xmit(skb, dev);
+}
+
+static void ax_tx_timeout(struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	ax_trace_enter(ei_local, AX_CTX_TX_TIMEOUT);
+	ax_ei_tx_timeout(dev);
+	ax_trace_leave(ei_local, AX_CTX_TX_TIMEOUT);
+}
+
+static void ax_tx_work(struct work_struct *work)
+{
+	struct ei_device *ei_local;
+
+	ei_local = container_of(work, struct ei_device, tx_work);
+	ax_trace_enter(ei_local, AX_CTX_TX_WORK);
+	ei_tx_work(work);
+	ax_trace_leave(ei_local, AX_CTX_TX_WORK);
+}
+
 static const struct net_device_ops ax_netdev_ops = {
 	.ndo_open		= ax_open,
 	.ndo_stop		= ax_close,
 	.ndo_do_ioctl		= ax_ioctl,
 
-	.ndo_start_xmit		= ax_ei_start_xmit,
-	.ndo_tx_timeout		= ax_ei_tx_timeout,
+	.ndo_start_xmit		= ax_start_xmit,
+	.ndo_tx_timeout		= ax_tx_timeout,
 	.ndo_get_stats		= ax_ei_get_stats,
 	.ndo_set_rx_mode	= ax_ei_set_multicast_list,
 	.ndo_validate_addr	= eth_validate_addr,
@@ -665,45 +1605,158 @@ static const struct net_device_ops ax_netdev_ops = {
 #endif
 };
 
+/*
+ * sysfs: stage_timing results, in /sys/class/net/<if>/ax88796/. Figures
+ * cover the time since the board was set up or stage_reset was written,
+ * so reset after turning stage_timing on.
+ */
+static const char * const ax_stage_names[EI_STAGE_NR] = {
+	[EI_STAGE_IRQ]		= "irq",
+	[EI_STAGE_HDR]		= "rx_hdr",
+	[EI_STAGE_ALLOC]	= "rx_alloc",
+	[EI_STAGE_RX_COPY]	= "rx_copy",
+	[EI_STAGE_NETIF_RX]	= "netif_rx",
+	[EI_STAGE_UPLOAD]	= "tx_upload",
+	[EI_STAGE_RDC]		= "tx_rdc",
+	[EI_STAGE_TRIGGER]	= "tx_trigger",
+};
+
+static u64 ax_acct_window(struct ax_device *ax)
+{
+	return ktime_get_ns() - ax->acct_start ?: 1;
+}
+
+/* one line per stage: name, count, total ns, mean ns */
+static ssize_t ax_stages_show(struct device *d, struct device_attribute *attr,
+			      char *buf)
+{
+	struct ax_device *ax = to_ax_dev(to_net_dev(d));
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < EI_STAGE_NR; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-10s %10lu %14llu %8llu\n",
+				 ax_stage_names[i], ax->stage_n[i],
+				 ax->stage_ns[i],
+				 ax->stage_n[i] ?
+				 div_u64(ax->stage_ns[i], ax->stage_n[i]) : 0);
+	return len;
+}
+
+/* share of wall time the remote DMA channel was moving data, percent */
+static ssize_t ax_bus_busy_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	struct ax_device *ax = to_ax_dev(to_net_dev(d));
+
+	return sprintf(buf, "%llu\n",
+		       div64_u64(ax->bus_ns * 100, ax_acct_window(ax)));
+}
+
+/* bytes moved over remote DMA per second */
+static ssize_t ax_bus_rate_show(struct device *d,
+				struct device_attribute *attr, char *buf)
+{
+	struct ax_device *ax = to_ax_dev(to_net_dev(d));
+	u64 ms = div_u64(ax_acct_window(ax), NSEC_PER_MSEC) ?: 1;
+
+	return sprintf(buf, "%llu\n", div64_u64(ax->bus_bytes * MSEC_PER_SEC, ms));
+}
+
+static ssize_t ax_stage_reset_store(struct device *d,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct net_device *dev = to_net_dev(d);
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ei_local->page_lock, flags);
+	memset(ax->stage_ns, 0, sizeof(ax->stage_ns));
+	memset(ax->stage_n, 0, sizeof(ax->stage_n));
+	ax->bus_ns = 0;
+	ax->bus_bytes = 0;
+	ax->acct_start = ktime_get_ns();
+	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+
+	return count;
+}
+
+static DEVICE_ATTR(stages, 0444, ax_stages_show, NULL);
+static DEVICE_ATTR(bus_busy, 0444, ax_bus_busy_show, NULL);
+static DEVICE_ATTR(bus_rate, 0444, ax_bus_rate_show, NULL);
+static DEVICE_ATTR(stage_reset, 0200, NULL, ax_stage_reset_store);
+
+static struct attribute *ax_attrs[] = {
+	&dev_attr_stages.attr,
+	&dev_attr_bus_busy.attr,
+	&dev_attr_bus_rate.attr,
+	&dev_attr_stage_reset.attr,
+	NULL
+};
+
+static const struct attribute_group ax_attr_group = {
+	.name	= DRV_NAME,
+	.attrs	= ax_attrs,
+};
+
+/* MEMR is write-only from our side: only touch the bus if a bit moved */
+static void ax_bb_write(struct ax_device *ax, u8 memr)
+{
+	struct ei_device *ei_local = ax_to_ei(ax);
+
+	if (memr == ax->reg_memr)
+		return;
+
+	ax->reg_memr = memr;
+	ei_outb(memr, ax->addr_memr);
+}
+
 static void ax_bb_mdc(struct mdiobb_ctrl *ctrl, int level)
 {
 	struct ax_device *ax = container_of(ctrl, struct ax_device, bb_ctrl);
+	u8 memr = ax->reg_memr;
 
 	if (level)
-		ax->reg_memr |= AX_MEMR_MDC;
+		memr |= AX_MEMR_MDC;
 	else
-		ax->reg_memr &= ~AX_MEMR_MDC;
+		memr &= ~AX_MEMR_MDC;
 
-	ei_outb(ax->reg_memr, ax->addr_memr);
+	ax_bb_write(ax, memr);
 }
 
 static void ax_bb_dir(struct mdiobb_ctrl *ctrl, int output)
 {
 	struct ax_device *ax = container_of(ctrl, struct ax_device, bb_ctrl);
+	u8 memr = ax->reg_memr;
 
 	if (output)
-		ax->reg_memr &= ~AX_MEMR_MDIR;
+		memr &= ~AX_MEMR_MDIR;
 	else
-		ax->reg_memr |= AX_MEMR_MDIR;
+		memr |= AX_MEMR_MDIR;
 
-	ei_outb(ax->reg_memr, ax->addr_memr);
+	ax_bb_write(ax, memr);
 }
 
 static void ax_bb_set_data(struct mdiobb_ctrl *ctrl, int value)
 {
 	struct ax_device *ax = container_of(ctrl, struct ax_device, bb_ctrl);
+	u8 memr = ax->reg_memr;
 
 	if (value)
-		ax->reg_memr |= AX_MEMR_MDO;
+		memr |= AX_MEMR_MDO;
 	else
-		ax->reg_memr &= ~AX_MEMR_MDO;
+		memr &= ~AX_MEMR_MDO;
 
-	ei_outb(ax->reg_memr, ax->addr_memr);
+	ax_bb_write(ax, memr);
 }
 
 static int ax_bb_get_data(struct mdiobb_ctrl *ctrl)
 {
 	struct ax_device *ax = container_of(ctrl, struct ax_device, bb_ctrl);
+	struct ei_device *ei_local = ax_to_ei(ax);
 	int reg_memr = ei_inb(ax->addr_memr);
 
 	return reg_memr & AX_MEMR_MDI ? 1 : 0;
@@ -721,13 +1774,13 @@ static struct mdiobb_ops bb_ops = {
 
 static int ax_mii_init(struct net_device *dev)
 {
-	struct zorro_dev *zdev = to_zorro_dev(dev->dev.parent);
 	struct ei_device *ei_local = netdev_priv(dev);
 	struct ax_device *ax = to_ax_dev(dev);
 	int err, i;
 
 	ax->bb_ctrl.ops = &bb_ops;
 	ax->addr_memr = ei_local->mem + AX_MEMR;
+	ei_outb(ax->reg_memr, ax->addr_memr);	/* ax_bb_write() trusts the cache */
 	ax->mii_bus = alloc_mdio_bitbang(&ax->bb_ctrl);
 	if (!ax->mii_bus) {
 		err = -ENOMEM;
@@ -736,8 +1789,8 @@ static int ax_mii_init(struct net_device *dev)
 
 	ax->mii_bus->name = "ax88796_mii_bus";
 	ax->mii_bus->parent = dev->dev.parent;
-	snprintf(ax->mii_bus->id, MII_BUS_ID_SIZE, "%s-%x",
-		zdev->name, zdev->id);
+	snprintf(ax->mii_bus->id, MII_BUS_ID_SIZE, "%s-%s",
+		ax_bus(ei_local)->name, dev_name(dev->dev.parent));
 
 	ax->mii_bus->irq = kmalloc(sizeof(int) * PHY_MAX_ADDR, GFP_KERNEL);
 	if (!ax->mii_bus->irq) {
@@ -746,7 +1799,7 @@ static int ax_mii_init(struct net_device *dev)
 	}
 
 	for (i = 0; i < PHY_MAX_ADDR; i++)
-		ax->mii_bus->irq[i] = PHY_POLL;
+		ax->mii_bus->irq[i] = PHY_IGNORE_INTERRUPT;
 
 	err = mdiobus_register(ax->mii_bus);
 	if (err)
@@ -758,21 +1811,367 @@ static int ax_mii_init(struct net_device *dev)
 	kfree(ax->mii_bus->irq);
  out_free_mdio_bitbang:
 	free_mdio_bitbang(ax->mii_bus);
+	ax->mii_bus = NULL;
  out:
 	return err;
 }
 
-static void ax_initial_setup(struct net_device *dev, struct ei_device *ei_local)
+/*
+ * Registering the bitbanged MDIO bus scans all 32 addresses over slow
+ * bus cycles, so it is done from a work item rather than in probe or
+ * open. It is queued before register_netdev(); ax_open() waits for it
+ * and retries the PHY probe if it found nothing.
+ */
+static void ax_mii_work(struct work_struct *work)
 {
-	void __iomem *ioaddr = ei_local->mem;
-	struct ax_device *ax = to_ax_dev(dev);
+	struct ax_device *ax = container_of(work, struct ax_device, mii_work);
+	struct net_device *dev = ax_to_ei(ax)->dev;
+	int ret;
+
+	ret = ax_mii_init(dev);
+	if (ret) {
+		netdev_err(dev, "MII bus setup failed (%d)\n", ret);
+		return;
+	}
+
+	/* the PHY stays attached until the board goes away */
+	ret = ax_mii_probe(dev);
+	if (ret)
+		netdev_warn(dev, "PHY probe failed (%d), retrying on open\n",
+			    ret);
+}
+
+static void ax_mii_remove(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	cancel_work_sync(&ax->mii_work);
+	if (!ax->mii_bus)
+		return;
+
+	if (ax->phy_dev) {
+		phy_disconnect(ax->phy_dev);
+		ax->phy_dev = NULL;
+	}
+	mdiobus_unregister(ax->mii_bus);
+	kfree(ax->mii_bus->irq);
+	free_mdio_bitbang(ax->mii_bus);
+	ax->mii_bus = NULL;
+}
+
+static void ax_initial_setup(struct net_device *dev, struct ei_device *ei_local)
+{
+	void __iomem *ioaddr = ei_local->mem;
+	struct ax_device *ax = to_ax_dev(dev);
 
 	/* Select page 0 */
 	ei_outb(E8390_NODMA + E8390_PAGE0 + E8390_STOP, ioaddr + E8390_CMD);
 
 	/* set to byte access */
 	ei_outb(ax->plat->dcr_val & ~1, ioaddr + EN0_DCFG);
-	ei_outb(ax->plat->gpoc_val, ioaddr + EI_SHIFT(0x17));
+	if (ax_bus(ei_local)->has_mii)
+		ei_outb(ax->plat->gpoc_val, ioaddr + EI_SHIFT(0x17));
+}
+
+/*
+ * ax_read_prom
+ *
+ * fetch the station address PROM. On word-mode boards this is a single
+ * remote DMA burst through the bus data path (the 32-bit FIFO on the
+ * X-Surf 100); if that does not give a usable address, fall back to the
+ * byte-wide NE_DATAPORT reads which work everywhere.
+ */
+static void ax_read_prom(struct net_device *dev, unsigned char *prom, int len)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	void __iomem *ioaddr = ei_local->mem;
+	unsigned char mac[ETH_ALEN];
+	int i;
+
+	if (ax->plat->wordlength == 2) {
+		struct ax_dma_job job = {
+			.op	= AX_DMA_PROM,
+			.addr	= 0,
+			.count	= len,
+			.buf.in	= prom,
+		};
+
+		ei_outb(ax->plat->dcr_val, ioaddr + EN0_DCFG);
+		ax_dma_submit(dev, &job);
+		ei_outb(ax->plat->dcr_val & ~1, ioaddr + EN0_DCFG);
+
+		for (i = 0; i < ETH_ALEN; i++)
+			mac[i] = prom[i + i];
+		if (is_valid_ether_addr(mac))
+			return;
+
+		netdev_dbg(dev, "FIFO PROM read gave %pM, retrying bytewise\n",
+			   mac);
+	}
+
+	ei_outb(6, ioaddr + EN0_RCNTLO);
+	ei_outb(0, ioaddr + EN0_RCNTHI);
+	ei_outb(0, ioaddr + EN0_RSARLO);
+	ei_outb(0, ioaddr + EN0_RSARHI);
+	ei_outb(E8390_RREAD+E8390_START, ioaddr + NE_CMD);
+	for (i = 0; i < len; i += 2) {
+		prom[i] = ei_inb(ioaddr + NE_DATAPORT);
+		prom[i + 1] = ei_inb(ioaddr + NE_DATAPORT);
+	}
+	ei_outb(ENISR_RDC, ioaddr + EN0_ISR);	/* Ack intr. */
+}
+
+static const char * const ax_win_names[EI_WIN_NR] = {
+	[EI_WIN_HARDIRQ]	= "hardirq",
+	[EI_WIN_TX]		= "tx_claim",
+	[EI_WIN_TIMEOUT]	= "tx_timeout",
+	[EI_WIN_OVERRUN]	= "rx_overrun",
+	[EI_WIN_STATS]		= "stats",
+	[EI_WIN_MCAST]		= "mcast",
+};
+
+static int ax_win_show(struct seq_file *m, void *v)
+{
+	struct ax_device *ax = to_ax_dev(m->private);
+	int win, i;
+
+	seq_puts(m, "section        count     max_ns\n");
+	for (win = 0; win < EI_WIN_NR; win++)
+		seq_printf(m, "%-10s %9lu %10llu\n", ax_win_names[win],
+			   ax->win_n[win], ax->win_max[win]);
+
+	seq_puts(m, "\nlog2 buckets (bucket n: < 2^n us)\n");
+	for (win = 0; win < EI_WIN_NR; win++) {
+		seq_printf(m, "%-10s", ax_win_names[win]);
+		for (i = 0; i < AX_WIN_BUCKETS; i++)
+			seq_printf(m, " %lu", ax->win_hist[win][i]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static int ax_win_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ax_win_show, inode->i_private);
+}
+
+/* any write clears the histograms */
+static ssize_t ax_win_write(struct file *file, const char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct net_device *dev = m->private;
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ei_local->page_lock, flags);
+	memset(ax->win_n, 0, sizeof(ax->win_n));
+	memset(ax->win_max, 0, sizeof(ax->win_max));
+	memset(ax->win_hist, 0, sizeof(ax->win_hist));
+	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations ax_win_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ax_win_open,
+	.read		= seq_read,
+	.write		= ax_win_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const char * const ax_fault_names[EI_FAULT_NR] = {
+	[EI_FAULT_RX_OVERRUN]	= "rx_overrun",
+	[EI_FAULT_RX_PAGE]	= "rx_page",
+	[EI_FAULT_RX_BOGUS]	= "rx_bogus",
+	[EI_FAULT_TX_TIMEOUT]	= "tx_timeout",
+	[EI_FAULT_RESET]	= "reset",
+	[EI_FAULT_RDC]		= "rdc",
+};
+
+static int ax_rec_show(struct seq_file *m, void *v)
+{
+	struct ax_device *ax = to_ax_dev(m->private);
+	int i;
+
+	seq_puts(m, "path           runs  injected     avg_ns     max_ns  lost\n");
+	for (i = 0; i < EI_FAULT_NR; i++)
+		seq_printf(m, "%-10s %8lu %9lu %10llu %10llu %5lu\n",
+			   ax_fault_names[i], ax->rec_n[i], ax->rec_injected[i],
+			   ax->rec_n[i] ? div_u64(ax->rec_ns[i], ax->rec_n[i]) : 0,
+			   ax->rec_max[i], ax->rec_lost[i]);
+	return 0;
+}
+
+static int ax_rec_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ax_rec_show, inode->i_private);
+}
+
+/* any write clears the counters */
+static ssize_t ax_rec_write(struct file *file, const char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct net_device *dev = m->private;
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ei_local->page_lock, flags);
+	memset(ax->rec_n, 0, sizeof(ax->rec_n));
+	memset(ax->rec_injected, 0, sizeof(ax->rec_injected));
+	memset(ax->rec_ns, 0, sizeof(ax->rec_ns));
+	memset(ax->rec_max, 0, sizeof(ax->rec_max));
+	memset(ax->rec_lost, 0, sizeof(ax->rec_lost));
+	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations ax_rec_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ax_rec_open,
+	.read		= seq_read,
+	.write		= ax_rec_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#ifdef CONFIG_AX88796_TRACE
+static const char * const ax_trace_kinds[AX_TR_KINDS] = {
+	[AX_TR_RD8]		= "r8",
+	[AX_TR_WR8]		= "w8",
+	[AX_TR_RD16]		= "r16",
+	[AX_TR_WR16]		= "w16",
+	[AX_TR_FIFO_IN]		= "fifo_in",
+	[AX_TR_FIFO_OUT]	= "fifo_out",
+	[AX_TR_DATA]		= "data",
+	[AX_TR_ENTER]		= "enter",
+	[AX_TR_LEAVE]		= "leave",
+	[AX_TR_XMIT]		= "xmit",
+};
+
+static const char * const ax_trace_ctxs[AX_CTX_NR] = {
+	[AX_CTX_OPEN]		= "open",
+	[AX_CTX_CLOSE]		= "close",
+	[AX_CTX_IRQ]		= "irq",
+	[AX_CTX_TX_WORK]	= "tx_work",
+	[AX_CTX_TX_TIMEOUT]	= "tx_timeout",
+};
+
+/* for the 16 bit data port values; FIFO data is recorded as bytes */
+#ifdef __BIG_ENDIAN
+#define AX_TRACE_ENDIAN	"big"
+#else
+#define AX_TRACE_ENDIAN	"little"
+#endif
+
+/*
+ * oldest first: ns, kind, register offset, value; data records give the
+ * offset into the burst and the bytes as they were in memory
+ */
+static int ax_trace_show(struct seq_file *m, void *v)
+{
+	struct ax_device *ax = to_ax_dev(m->private);
+	unsigned long i = 0;
+
+	seq_printf(m, "# %lu records, reg_base %#x stride %u, %s endian\n",
+		   ax->trace_head, ax_bus(ax_to_ei(ax))->reg_base,
+		   ax_bus(ax_to_ei(ax))->reg_stride, AX_TRACE_ENDIAN);
+
+	if (ax->trace_head > trace_entries)
+		i = ax->trace_head - trace_entries;
+
+	for (; i < ax->trace_head; i++) {
+		struct ax_trace_rec *rec = &ax->trace[i % trace_entries];
+
+		switch (rec->kind) {
+		case AX_TR_DATA:
+			seq_printf(m, "%llu data %#x %02x%02x%02x%02x\n",
+				   rec->ns, rec->off, rec->data[0],
+				   rec->data[1], rec->data[2], rec->data[3]);
+			break;
+		case AX_TR_ENTER:
+		case AX_TR_LEAVE:
+			seq_printf(m, "%llu %s 0 %s\n", rec->ns,
+				   ax_trace_kinds[rec->kind],
+				   ax_trace_ctxs[rec->val]);
+			break;
+		default:
+			seq_printf(m, "%llu %s %#x %#x\n", rec->ns,
+				   ax_trace_kinds[rec->kind], rec->off,
+				   rec->val);
+		}
+	}
+	return 0;
+}
+
+static int ax_trace_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ax_trace_show, inode->i_private);
+}
+
+/* any write empties the ring */
+static ssize_t ax_trace_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct ax_device *ax = to_ax_dev(m->private);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ax->trace_lock, flags);
+	ax->trace_head = 0;
+	spin_unlock_irqrestore(&ax->trace_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations ax_trace_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ax_trace_open,
+	.read		= seq_read,
+	.write		= ax_trace_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+/* per board debugfs dir, named after the bus device */
+static void ax_debugfs_init(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	ax->debugfs = debugfs_create_dir(dev_name(dev->dev.parent),
+					 ax_debugfs_root);
+	debugfs_create_file("irq_windows", S_IRUGO | S_IWUSR, ax->debugfs,
+			    dev, &ax_win_fops);
+	debugfs_create_file("recovery", S_IRUGO | S_IWUSR, ax->debugfs,
+			    dev, &ax_rec_fops);
+
+#ifdef CONFIG_AX88796_TRACE
+	spin_lock_init(&ax->trace_lock);
+	if (trace_entries)
+		ax->trace = vzalloc(trace_entries * sizeof(*ax->trace));
+	if (ax->trace)
+		debugfs_create_file("trace", S_IRUGO | S_IWUSR, ax->debugfs,
+				    dev, &ax_trace_fops);
+#endif
+}
+
+static void ax_debugfs_exit(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	debugfs_remove_recursive(ax->debugfs);
+#ifdef CONFIG_AX88796_TRACE
+	vfree(ax->trace);
+	ax->trace = NULL;
+#endif
 }
 
 /*
@@ -806,16 +2205,7 @@ static int ax_init_dev(struct net_device *dev)
 	if (ax->plat->flags & AXFLG_HAS_EEPROM) {
 		unsigned char SA_prom[32];
 
-		ei_outb(6, ioaddr + EN0_RCNTLO);
-		ei_outb(0, ioaddr + EN0_RCNTHI);
-		ei_outb(0, ioaddr + EN0_RSARLO);
-		ei_outb(0, ioaddr + EN0_RSARHI);
-		ei_outb(E8390_RREAD+E8390_START, ioaddr + NE_CMD);
-		for (i = 0; i < sizeof(SA_prom); i += 2) {
-			SA_prom[i] = ei_inb(ioaddr + NE_DATAPORT);
-			SA_prom[i + 1] = ei_inb(ioaddr + NE_DATAPORT);
-		}
-		ei_outb(ENISR_RDC, ioaddr + EN0_ISR);	/* Ack intr. */
+		ax_read_prom(dev, SA_prom, sizeof(SA_prom));
 
 		if (ax->plat->wordlength == 2)
 			for (i = 0; i < 16; i++)
@@ -866,11 +2256,18 @@ static int ax_init_dev(struct net_device *dev)
 
 	ax_reset_8390(dev);
 
+	/* let the bus pick its fastest data path; needs word mode */
+	if (ax->plat->wordlength == 2 && ax_bus(ei_local)->calibrate)
+		ax_bus(ei_local)->calibrate(dev, start_page);
+
 	ei_local->name = "AX88796";
 	ei_local->tx_start_page = start_page;
 	ei_local->stop_page = stop_page;
 	ei_local->word16 = (ax->plat->wordlength == 2);
 	ei_local->rx_start_page = start_page + TX_PAGES;
+	ei_local->rx_high_water = (stop_page - ei_local->rx_start_page) *
+				  min(rx_watermark, 100U) / 100;
+	ei_local->tx_reserve = tx_reserve;
 
 #ifdef PACKETBUF_MEMSIZE
 	/* Allow the packet buffer size to be overridden by know-it-alls. */
@@ -885,153 +2282,1078 @@ static int ax_init_dev(struct net_device *dev)
 
 	dev->netdev_ops = &ax_netdev_ops;
 	dev->ethtool_ops = &ax_ethtool_ops;
+	dev->sysfs_groups[0] = &ax_attr_group;
 
 	ax_NS8390_init(dev, 0);
 
+	/* queued before the netdev is visible, so any open finds it */
+	if (ax_bus(ei_local)->has_mii)
+		schedule_work(&ax->mii_work);
+
 	ret = register_netdev(dev);
-	if (ret)
+	if (ret) {
+		ax_mii_remove(dev);
 		goto err_out;
+	}
 
 	netdev_info(dev, "%dbit, irq %d, %lx, MAC: %pM\n",
 		    ei_local->word16 ? 16 : 8, dev->irq, dev->base_addr,
 		    dev->dev_addr);
 
+	ax_debugfs_init(dev);
+
 	return 0;
 
  err_out:
 	return ret;
 }
 
-static void ax_remove(struct zorro_dev *zdev)
-{
-	struct net_device *dev = zorro_get_drvdata(zdev);
-	struct ei_device *ei_local = netdev_priv(dev);
-
-	unregister_netdev(dev);
-
-	z_iounmap(to_ax_dev(dev)->data_area);
-	release_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
-	z_iounmap(ei_local->mem);
-	release_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20);
-
-	free_netdev(dev);
-}
-
-static const struct ax_plat_data xsurf100_plat_data = {
-	.flags = AXFLG_HAS_EEPROM,
-	.wordlength = 2,
-	.dcr_val = 0x48,
-	.rcr_val = 0x40,
-};
-
 /*
- * ax_probe
+ * ax_alloc_dev
  *
- * This is the entry point when the platform device system uses to
- * notify us of a new device to attach to. Allocate memory, find the
- * resources and information passed, and map the necessary registers.
+ * allocate the net_device for a board found by one of the bus front
+ * ends and record what the engine needs to know about the bus. The
+ * front end still has to map the registers and set the irq.
  */
-static int ax_probe(struct zorro_dev *zdev, const struct zorro_device_id *ent)
+static struct net_device *ax_alloc_dev(struct device *parent,
+				       const struct ax_bus_ops *ops,
+				       const struct ax_plat_data *plat)
 {
 	struct net_device *dev;
 	struct ei_device *ei_local;
 	struct ax_device *ax;
-	int ret = 0;
+#ifndef CONFIG_AX88796_XSURF_ONLY
+	int i;
+#endif
 
 	dev = ax__alloc_ei_netdev(sizeof(struct ax_device));
 	if (dev == NULL)
-		return -ENOMEM;
+		return NULL;
 
-	/* ok, let's setup our device */
-	SET_NETDEV_DEV(dev, &zdev->dev);
+	SET_NETDEV_DEV(dev, parent);
 	ei_local = netdev_priv(dev);
 	ax = to_ax_dev(dev);
 
-	ax->plat = &xsurf100_plat_data;
-	zorro_set_drvdata(zdev, dev);
-
-	ei_local->rxcr_base = ax->plat->rcr_val;
-
-	dev->irq = IRQ_AMIGA_PORTS;
-	ax->irqflags = IRQF_SHARED;
+	ax->plat = plat;
+	INIT_WORK(&ax->mii_work, ax_mii_work);
+	INIT_DELAYED_WORK(&ax->link_work, ax_link_work);
+	/* in place of ei_tx_work(), to mark its runs in the trace */
+	INIT_WORK(&ei_local->tx_work, ax_tx_work);
+	ax->acct_start = ktime_get_ns();
+	ei_local->bus_ops = ops;
+	ei_local->rxcr_base = plat->rcr_val;
 
+#ifndef CONFIG_AX88796_XSURF_ONLY
 	ei_local->reg_offset = ax->reg_offsets;
-	for (ret = 0; ret < 0x20; ret++)
-		ax->reg_offsets[ret] = 4 * ret + XS100_8390_BASE;
-
-	if (!request_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20, "X-Surf 100 8390 registers")) {
-		dev_err(&zdev->dev, "cannot reserve registers\n");
-		ret = -ENXIO;
-		goto exit_mem;
-	}
+	for (i = 0; i < 0x20; i++)
+		ax->reg_offsets[i] = ops->reg_base + ops->reg_stride * i;
+#endif
 
-	ei_local->mem = z_ioremap(zdev->resource.start, XS100_8390_BASE + 4*0x20);
-	dev->base_addr = (unsigned long)ei_local->mem;
+	return dev;
+}
 
-	if (ei_local->mem == NULL) {
-		dev_err(&zdev->dev, "Cannot ioremap area %pR\n", (void*)zdev->resource.start);
+#ifdef CONFIG_AX88796_PROFILE
+/*
+ * Register access profiler. Every accessor bumps the running totals and
+ * a counter for the function it sits in; lib8390 brackets its logical
+ * operations with ei_prof_begin()/ei_prof_end(), which turns the totals
+ * into per operation sums and a log2 histogram of bus cycles (a FIFO
+ * longword is two 16-bit cycles on the card). Counters are shared by all
+ * boards and are not SMP safe; this is a measurement build only.
+ */
+#define AX_PROF_SITES	48
+#define AX_PROF_BUCKETS	16
 
-		ret = -ENXIO;
-		goto exit_req;
-	}
+struct ax_prof_site {
+	const char *func;
+	unsigned long n[AX_PROF_KINDS];
+};
 
-	if (!request_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE, "X-Surf 100 32-bit data access")) {
-		dev_err(&zdev->dev, "cannot reserve 32-bit area\n");
-		ret = -ENXIO;
-		goto exit_mem2;
-	}
+static struct {
+	unsigned long total[AX_PROF_KINDS];
+	unsigned long start[EI_PROF_NR][AX_PROF_KINDS];
+	unsigned long op[EI_PROF_NR][AX_PROF_KINDS];
+	unsigned long count[EI_PROF_NR];
+	unsigned long hist[EI_PROF_NR][AX_PROF_BUCKETS];
+	struct ax_prof_site site[AX_PROF_SITES];
+} ax_prof;
+
+static const char * const ax_prof_op_names[EI_PROF_NR] = {
+	[EI_PROF_RX]	= "rx_frame",
+	[EI_PROF_TX]	= "tx_frame",
+	[EI_PROF_IRQ]	= "irq_round",
+	[EI_PROF_MCAST]	= "mcast",
+	[EI_PROF_STATS]	= "stats",
+};
 
-	ax->data_area = z_ioremap(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
+static void ax_prof_access(const char *site, int kind, unsigned int n)
+{
+	int i;
 
-	if(ax->data_area == NULL)
-	{
-		dev_err(&zdev->dev, "Cannot ioremap area %pR (32-bit access)\n", (void*)zdev->resource.start + XS100_8390_DATA32_BASE);
+	ax_prof.total[kind] += n;
 
-		ret = -ENXIO;
-		goto exit_req2;
+	for (i = 0; i < AX_PROF_SITES; i++) {
+		if (!ax_prof.site[i].func)
+			ax_prof.site[i].func = site;
+		if (ax_prof.site[i].func == site) {
+			ax_prof.site[i].n[kind] += n;
+			break;
+		}
 	}
+}
 
-	ax->xs100irqstatusreg = (char __iomem*)ei_local->mem + XS100_IRQSTATUS_BASE;
-	ax->xs100readfifo = ax->data_area + XS100_8390_DATA_READ32_BASE;
-	ax->xs100writefifo = ax->data_area + XS100_8390_DATA_WRITE32_BASE;
+static void ax_prof_begin(int op)
+{
+	memcpy(ax_prof.start[op], ax_prof.total, sizeof(ax_prof.total));
+}
 
-	/* got resources, now initialise and register device */
-	ret = ax_init_dev(dev);
-	if (!ret)
-		return 0;
+static void ax_prof_end(int op)
+{
+	unsigned long delta, cycles = 0;
+	int kind;
 
-	z_iounmap(ei_local->mem);
+	for (kind = 0; kind < AX_PROF_KINDS; kind++) {
+		delta = ax_prof.total[kind] - ax_prof.start[op][kind];
+		ax_prof.op[op][kind] += delta;
+		cycles += kind == AX_PROF_FIFO ? 2 * delta : delta;
+	}
 
- exit_req2:
-	release_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
+	ax_prof.count[op]++;
+	ax_prof.hist[op][min_t(int, fls(cycles), AX_PROF_BUCKETS - 1)]++;
+}
 
- exit_mem2:
-	z_iounmap(ax->data_area);
+static int ax_prof_show(struct seq_file *m, void *v)
+{
+	int op, i;
+
+	seq_puts(m, "op          count      reads     writes     fifo32\n");
+	for (op = 0; op < EI_PROF_NR; op++)
+		seq_printf(m, "%-9s %7lu %10lu %10lu %10lu\n",
+			   ax_prof_op_names[op], ax_prof.count[op],
+			   ax_prof.op[op][AX_PROF_READ],
+			   ax_prof.op[op][AX_PROF_WRITE],
+			   ax_prof.op[op][AX_PROF_FIFO]);
+
+	seq_puts(m, "\nbus cycles per op, log2 buckets (bucket n: < 2^n)\n");
+	for (op = 0; op < EI_PROF_NR; op++) {
+		seq_printf(m, "%-9s", ax_prof_op_names[op]);
+		for (i = 0; i < AX_PROF_BUCKETS; i++)
+			seq_printf(m, " %lu", ax_prof.hist[op][i]);
+		seq_puts(m, "\n");
+	}
 
- exit_req:
-	release_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20);
+	seq_puts(m, "\nsite                           reads     writes     fifo32\n");
+	for (i = 0; i < AX_PROF_SITES && ax_prof.site[i].func; i++)
+		seq_printf(m, "%-24s %10lu %10lu %10lu\n",
+			   ax_prof.site[i].func,
+			   ax_prof.site[i].n[AX_PROF_READ],
+			   ax_prof.site[i].n[AX_PROF_WRITE],
+			   ax_prof.site[i].n[AX_PROF_FIFO]);
+	return 0;
+}
 
- exit_mem:
-	free_netdev(dev);
+static int ax_prof_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ax_prof_show, NULL);
+}
 
-	return ret;
+/* any write clears the profile */
+static ssize_t ax_prof_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	memset(&ax_prof, 0, sizeof(ax_prof));
+	return count;
 }
 
-#define ZORRO_PROD_INDIVIDUAL_COMPUTERS_X_SURF100 ZORRO_ID(INDIVIDUAL_COMPUTERS, 0x64, 0)
-static struct zorro_device_id xsurf100_zorro_tbl[] = {
-	{ ZORRO_PROD_INDIVIDUAL_COMPUTERS_X_SURF100, },
-	{ 0 }
+static const struct file_operations ax_prof_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ax_prof_open,
+	.read		= seq_read,
+	.write		= ax_prof_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
 };
-MODULE_DEVICE_TABLE(zorro, xsurf100_zorro_tbl);
+#endif
 
-static struct zorro_driver xsurf100_driver = {
-	.name		= "xsurf100",
-	.id_table	= xsurf100_zorro_tbl,
-	.probe		= ax_probe,
-	.remove		= ax_remove,
-};
+#ifdef CONFIG_ZORRO
+/* X-Surf 100 front end */
+
+/*
+ * FIFO copy kernels. Each moves a multiple of four bytes between memory
+ * and one of the 32-bit FIFO windows; the callers deal with the tail.
+ * Which one is fastest depends on the CPU, on whether the board sits in
+ * Zorro II or Zorro III space and on the alignment of the buffer, so
+ * ax_calibrate_copy() times them against the card and picks per case.
+ */
+typedef void (*ax_fifo_in_t)(void *dst, const void __iomem *fifo, unsigned count);
+typedef void (*ax_fifo_out_t)(void __iomem *fifo, const void *src, unsigned count);
 
-module_driver(xsurf100_driver, zorro_register_driver, zorro_unregister_driver);
+#ifdef CONFIG_M68K
+/* These functions guarantee that the iomem is accessed with 32 bit
+   cycles only. z_memcpy_fromio / z_memcpy_toio don't */
+static void z_memcpy_fromio32(void *dst, const void __iomem *src, size_t bytes)
+{
+	while(bytes > 32)
+	{
+		asm __volatile__ (
+                    "movem.l (%0)+,%%d0-%%d7\n"
+		    "movem.l %%d0-%%d7,(%1)\n"
+		    "adda.l #32,%1" : "=a"(src), "=a"(dst)
+		    : "0"(src), "1"(dst) : "d0","d1","d2","d3","d4","d5","d6","d7","memory");
+		bytes -= 32;
+	}
+	while(bytes)
+	{
+		*(uint32_t*)dst = ax_readl(src);
+		src += 4;
+		dst += 4;
+		bytes -= 4;
+	}
+}
+
+static void z_memcpy_toio32(void __iomem *dst, const void *src, size_t bytes)
+{
+	while(bytes > 32)
+	{
+		asm __volatile__ (
+		    "movem.l (%0)+,%%d0-%%d7\n"
+		    "movem.l %%d0-%%d7,(%1)\n"
+		    "adda.l #32,%1" : "=a"(src), "=a"(dst)
+		    : "0"(src), "1"(dst) : "d0","d1","d2","d3","d4","d5","d6","d7","memory");
+		bytes -= 32;
+	}
+	while(bytes)
+	{
+		ax_writel(*(const uint32_t*)src, dst);
+		src += 4;
+		dst += 4;
+		bytes -= 4;
+	}
+}
+
+/* movem.l bursts walking the window, chunked to its size */
+static void ax_fifo_in_movem(void *dst, const void __iomem *fifo, unsigned count)
+{
+	while (count > XS100_8390_DATA_AREA_SIZE) {
+		z_memcpy_fromio32(dst, fifo, XS100_8390_DATA_AREA_SIZE);
+		dst += XS100_8390_DATA_AREA_SIZE;
+		count -= XS100_8390_DATA_AREA_SIZE;
+	}
+	z_memcpy_fromio32(dst, fifo, count);
+}
+
+static void ax_fifo_out_movem(void __iomem *fifo, const void *src, unsigned count)
+{
+	while (count > XS100_8390_DATA_AREA_SIZE) {
+		z_memcpy_toio32(fifo, src, XS100_8390_DATA_AREA_SIZE);
+		src += XS100_8390_DATA_AREA_SIZE;
+		count -= XS100_8390_DATA_AREA_SIZE;
+	}
+	z_memcpy_toio32(fifo, src, count);
+}
+#endif
+
+/* unrolled longwords, all on the first address of the window */
+static void ax_fifo_in_long(void *dst, const void __iomem *fifo, unsigned count)
+{
+	uint32_t *d = dst;
+
+	for (; count >= 16; count -= 16, d += 4) {
+		d[0] = ax_readl(fifo);
+		d[1] = ax_readl(fifo);
+		d[2] = ax_readl(fifo);
+		d[3] = ax_readl(fifo);
+	}
+	for (; count; count -= 4)
+		*d++ = ax_readl(fifo);
+}
+
+static void ax_fifo_out_long(void __iomem *fifo, const void *src, unsigned count)
+{
+	const uint32_t *s = src;
+
+	for (; count >= 16; count -= 16, s += 4) {
+		ax_writel(s[0], fifo);
+		ax_writel(s[1], fifo);
+		ax_writel(s[2], fifo);
+		ax_writel(s[3], fifo);
+	}
+	for (; count; count -= 4)
+		ax_writel(*s++, fifo);
+}
+
+/*
+ * Alignment fixing variants for buffers that sit on a 2 mod 4 address,
+ * as skb->data does after skb_reserve(skb, 2): split or join each
+ * longword so that memory only sees aligned word cycles.
+ */
+#ifdef __BIG_ENDIAN
+#define AX_HI16(v)	((uint16_t)((v) >> 16))
+#define AX_LO16(v)	((uint16_t)(v))
+#else
+#define AX_HI16(v)	((uint16_t)(v))
+#define AX_LO16(v)	((uint16_t)((v) >> 16))
+#endif
+
+static void ax_fifo_in_split(void *dst, const void __iomem *fifo, unsigned count)
+{
+	uint16_t *d = dst;
+	uint32_t v;
+
+	for (; count; count -= 4, d += 2) {
+		v = ax_readl(fifo);
+		d[0] = AX_HI16(v);
+		d[1] = AX_LO16(v);
+	}
+}
+
+static void ax_fifo_out_join(void __iomem *fifo, const void *src, unsigned count)
+{
+	const uint16_t *s = src;
+
+	for (; count; count -= 4, s += 2)
+#ifdef __BIG_ENDIAN
+		ax_writel((uint32_t)s[0] << 16 | s[1], fifo);
+#else
+		ax_writel((uint32_t)s[1] << 16 | s[0], fifo);
+#endif
+}
+
+struct ax_fifo_kernel {
+	const char *name;
+	ax_fifo_in_t in;
+	ax_fifo_out_t out;
+};
+
+static const struct ax_fifo_kernel ax_fifo_kernels[] = {
+#ifdef CONFIG_M68K
+	{ "movem",	ax_fifo_in_movem,	ax_fifo_out_movem },
+#endif
+	{ "long",	ax_fifo_in_long,	ax_fifo_out_long },
+	{ "split",	ax_fifo_in_split,	ax_fifo_out_join },
+};
+
+/* index into ax_device.fifo_in[]/fifo_out[] from the buffer address */
+#define AX_ALIGN_IDX(p)	(((unsigned long)(p) >> 1) & 1)
+
+static void xs100_write(struct net_device *dev, const void *src, unsigned count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+
+	/* copy whole dwords */
+	ax_prof_fifo(count & ~3);
+	ax_trace_fifo(AX_TR_FIFO_OUT, src, count & ~3);
+	ax->fifo_out[AX_ALIGN_IDX(src)](ax->xs100writefifo, src, count & ~3);
+	src += count & ~3;
+	if(count & 2)
+	{
+		ei_outw(*(uint16_t*)src, ei_local->mem + NE_DATAPORT);
+		src += 2;
+	}
+	if(count & 1)
+	{
+		ei_outb(*(uint8_t*)src, ei_local->mem + NE_DATAPORT);
+	}
+}
+
+static void xs100_read(struct net_device *dev, void *dst, unsigned count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+
+	/* tiny transfers such as the packet header may be cheaper as words */
+	if (count <= ax->tiny_in) {
+		for (; count >= 2; count -= 2, dst += 2)
+			*(uint16_t*)dst = ei_inw(ei_local->mem + NE_DATAPORT);
+	}
+
+	/* copy whole dwords */
+	ax_prof_fifo(count & ~3);
+	ax->fifo_in[AX_ALIGN_IDX(dst)](dst, ax->xs100readfifo, count & ~3);
+	ax_trace_fifo(AX_TR_FIFO_IN, dst, count & ~3);
+	dst += count & ~3;
+	if(count & 2)
+	{
+		*(uint16_t*)dst = ei_inw(ei_local->mem + NE_DATAPORT);
+		dst += 2;
+	}
+	if(count & 1)
+	{
+		*(uint8_t*)dst = ei_inb(ei_local->mem + NE_DATAPORT);
+	}
+}
+
+/*
+ * Copy kernel calibration. Run once at probe time, after the board reset
+ * and with the chip in monitor mode, against the Tx buffer at @page:
+ * every kernel is first checked to move the data correctly and then
+ * timed over a few full sized transfers. The fastest one for each
+ * direction and alignment wins.
+ */
+#define AX_CALIB_LEN	1536	/* one Tx slot */
+#define AX_CALIB_ROUNDS	8
+
+static void ax_calib_rdma(struct net_device *dev, int cmd, int page, int count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *nic_base = ei_local->mem;
+
+	ei_outb(E8390_NODMA + E8390_PAGE0 + E8390_START, nic_base + NE_CMD);
+	ei_outb(ENISR_RDC, nic_base + EN0_ISR);
+	ei_outb(count & 0xff, nic_base + EN0_RCNTLO);
+	ei_outb(count >> 8, nic_base + EN0_RCNTHI);
+	ei_outb(0x00, nic_base + EN0_RSARLO);
+	ei_outb(page, nic_base + EN0_RSARHI);
+	ei_outb(cmd + E8390_START, nic_base + NE_CMD);
+}
+
+static int ax_calib_rdc(struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *nic_base = ei_local->mem;
+	unsigned long dma_start = jiffies;
+
+	while ((ei_inb(nic_base + EN0_ISR) & ENISR_RDC) == 0) {
+		if (jiffies - dma_start > 2 * HZ / 100)
+			return -ETIMEDOUT;
+	}
+	ei_outb(ENISR_RDC, nic_base + EN0_ISR);
+	return 0;
+}
+
+static int ax_calib_out(struct net_device *dev, int page, ax_fifo_out_t out,
+			const void *src)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	ax_calib_rdma(dev, E8390_RWRITE, page, AX_CALIB_LEN);
+	out(ax->xs100writefifo, src, AX_CALIB_LEN);
+	return ax_calib_rdc(dev);
+}
+
+static void ax_calib_in(struct net_device *dev, int page, ax_fifo_in_t in,
+			void *dst, int count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+
+	ax_calib_rdma(dev, E8390_RREAD, page, count);
+	in(dst, ax->xs100readfifo, count);
+	ei_outb(ENISR_RDC, ei_local->mem + EN0_ISR);
+}
+
+static const char *ax_fifo_name(ax_fifo_in_t in, ax_fifo_out_t out)
+{
+	const struct ax_fifo_kernel *k;
+
+	for (k = ax_fifo_kernels;
+	     k < ax_fifo_kernels + ARRAY_SIZE(ax_fifo_kernels); k++)
+		if ((in && k->in == in) || (out && k->out == out))
+			return k->name;
+	return "default";
+}
+
+static void ax_calibrate_copy(struct net_device *dev, int page)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	s64 in_ns[2] = { -1, -1 }, out_ns[2] = { -1, -1 };
+	s64 word_ns, long_ns;
+	const struct ax_fifo_kernel *k;
+	u8 *pattern, *work, hdr[4];
+	ktime_t start;
+	int align, i;
+
+	pattern = kmalloc(2 * AX_CALIB_LEN + 4, GFP_KERNEL);
+	if (!pattern)
+		return;
+	work = pattern + AX_CALIB_LEN;
+	for (i = 0; i < AX_CALIB_LEN; i++)
+		pattern[i] = i * 7 + 1;
+
+	/* the remote DMA needs the chip started; keep it off the wire */
+	ei_outb(E8390_RXOFF, ei_local->mem + EN0_RXCR);
+	ei_outb(E8390_TXOFF, ei_local->mem + EN0_TXCR);
+
+	for (k = ax_fifo_kernels;
+	     k < ax_fifo_kernels + ARRAY_SIZE(ax_fifo_kernels); k++) {
+		for (align = 0; align < 2; align++) {
+			u8 *buf = work + 2 * align;
+			s64 ns;
+
+			/* read side: the card holds the pattern */
+			if (ax_calib_out(dev, page, ax_fifo_out_long, pattern))
+				goto out;
+			memset(buf, 0, AX_CALIB_LEN);
+			ax_calib_in(dev, page, k->in, buf, AX_CALIB_LEN);
+			if (!memcmp(buf, pattern, AX_CALIB_LEN)) {
+				start = ktime_get();
+				for (i = 0; i < AX_CALIB_ROUNDS; i++)
+					ax_calib_in(dev, page, k->in, buf,
+						    AX_CALIB_LEN);
+				ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+				if (in_ns[align] < 0 || ns < in_ns[align]) {
+					in_ns[align] = ns;
+					ax->fifo_in[align] = k->in;
+				}
+			}
+
+			/* write side: read back what the kernel uploaded */
+			memcpy(buf, pattern, AX_CALIB_LEN);
+			if (ax_calib_out(dev, page, k->out, buf))
+				continue;
+			memset(buf, 0, AX_CALIB_LEN);
+			ax_calib_in(dev, page, ax_fifo_in_long, buf, AX_CALIB_LEN);
+			if (memcmp(buf, pattern, AX_CALIB_LEN))
+				continue;
+			memcpy(buf, pattern, AX_CALIB_LEN);
+			start = ktime_get();
+			for (i = 0; i < AX_CALIB_ROUNDS; i++)
+				ax_calib_out(dev, page, k->out, buf);
+			ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+			if (out_ns[align] < 0 || ns < out_ns[align]) {
+				out_ns[align] = ns;
+				ax->fifo_out[align] = k->out;
+			}
+		}
+	}
+
+	/* the 4 byte packet header: one longword or two data port words */
+	start = ktime_get();
+	for (i = 0; i < 16 * AX_CALIB_ROUNDS; i++)
+		ax_calib_in(dev, page, ax->fifo_in[0], hdr, sizeof(hdr));
+	long_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (i = 0; i < 16 * AX_CALIB_ROUNDS; i++) {
+		ax_calib_rdma(dev, E8390_RREAD, page, sizeof(hdr));
+		*(uint16_t *)&hdr[0] = ei_inw(ei_local->mem + NE_DATAPORT);
+		*(uint16_t *)&hdr[2] = ei_inw(ei_local->mem + NE_DATAPORT);
+		ei_outb(ENISR_RDC, ei_local->mem + EN0_ISR);
+	}
+	word_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	ax->tiny_in = word_ns < long_ns ? sizeof(hdr) : 0;
+
+	dev_info(dev->dev.parent,
+		 "FIFO copy: in %s/%s, out %s/%s, header via %s\n",
+		 ax_fifo_name(ax->fifo_in[0], NULL),
+		 ax_fifo_name(ax->fifo_in[1], NULL),
+		 ax_fifo_name(NULL, ax->fifo_out[0]),
+		 ax_fifo_name(NULL, ax->fifo_out[1]),
+		 ax->tiny_in ? "data port" : "FIFO");
+ out:
+	kfree(pattern);
+}
+
+static u8 xs100_readb(const void __iomem *addr)
+{
+	return ax_readb(addr);
+}
+
+static void xs100_writeb(u8 val, void __iomem *addr)
+{
+	ax_writeb(val, addr);
+}
+
+/*
+ * All X-Surf 100 boards raise INT2. Rather than one shared handler per
+ * board, the driver owns a single registration and polls the status
+ * register of every open board from it, servicing only those asserting.
+ */
+static LIST_HEAD(xs100_boards);
+static DEFINE_SPINLOCK(xs100_boards_lock);	/* list vs. the handler */
+static DEFINE_MUTEX(xs100_irq_mutex);		/* list vs. registration */
+
+static irqreturn_t xs100_interrupt(int irq, void *dev_id)
+{
+	struct ax_device *ax;
+	irqreturn_t ret = IRQ_NONE;
+
+	spin_lock(&xs100_boards_lock);
+	list_for_each_entry(ax, &xs100_boards, xs100_node) {
+		if (!(ax_readw(ax->xs100irqstatusreg) & 0x8000))
+			continue;
+
+		if (wrap_ax_ei_interrupt(irq, ax_to_ei(ax)->dev) == IRQ_HANDLED)
+			ret = IRQ_HANDLED;
+		else
+			ax->irq_spurious++;
+	}
+	spin_unlock(&xs100_boards_lock);
+
+	return ret;
+}
+
+static int xs100_request_irq(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+	unsigned long flags;
+	int ret = 0;
+
+	mutex_lock(&xs100_irq_mutex);
+	if (list_empty(&xs100_boards))
+		ret = request_irq(IRQ_AMIGA_PORTS, xs100_interrupt, IRQF_SHARED,
+				  "xsurf100", &xs100_boards);
+	if (!ret) {
+		spin_lock_irqsave(&xs100_boards_lock, flags);
+		list_add_tail(&ax->xs100_node, &xs100_boards);
+		spin_unlock_irqrestore(&xs100_boards_lock, flags);
+	}
+	mutex_unlock(&xs100_irq_mutex);
+
+	return ret;
+}
+
+static void xs100_free_irq(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+	unsigned long flags;
+
+	mutex_lock(&xs100_irq_mutex);
+	spin_lock_irqsave(&xs100_boards_lock, flags);
+	list_del(&ax->xs100_node);
+	spin_unlock_irqrestore(&xs100_boards_lock, flags);
+
+	if (list_empty(&xs100_boards))
+		free_irq(IRQ_AMIGA_PORTS, &xs100_boards);
+	mutex_unlock(&xs100_irq_mutex);
+}
+
+static const struct ax_bus_ops xs100_bus_ops = {
+	.name		= "zorro",
+	.readb		= xs100_readb,
+	.writeb		= xs100_writeb,
+	.read_data	= xs100_read,
+	.write_data	= xs100_write,
+	.request_irq	= xs100_request_irq,
+	.free_irq	= xs100_free_irq,
+	.calibrate	= ax_calibrate_copy,
+	.reg_base	= XS100_8390_BASE,
+	.reg_stride	= 4,
+	.has_mii	= true,
+};
+
+#ifdef CONFIG_AX88796_UIO
+static bool uio_mode;
+module_param(uio_mode, bool, 0444);
+MODULE_PARM_DESC(uio_mode, "Hand X-Surf 100 boards to a userspace poll-mode driver via UIO");
+
+/*
+ * UIO mode: the board is not registered as a netdev. A userspace
+ * poll-mode driver gets two maps through /dev/uioN instead:
+ *   map 0 "registers": 8390 registers at XS100_8390_BASE, stride 4
+ *   map 1 "data32": read FIFO at XS100_8390_DATA_READ32_BASE, write
+ *         FIFO at XS100_8390_DATA_WRITE32_BASE, for 32-bit remote DMA
+ * There is no interrupt. The chip is reset and left with its IMR
+ * masked so it never drives the shared INT2 line; userspace must keep
+ * it that way. tools/xsurf100-uio is such a driver, built from this file.
+ */
+static int xs100_uio_register(struct zorro_dev *zdev, struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	struct ax_device *ax = to_ax_dev(dev);
+	struct uio_info *info;
+	int ret;
+
+	info = kzalloc(sizeof(*info), GFP_KERNEL);
+	if (!info)
+		return -ENOMEM;
+
+	ax_reset_8390(dev);
+	ei_outb(0x00, ei_local->mem + EN0_IMR);
+	ei_outb(0xff, ei_local->mem + EN0_ISR);
+
+	info->name = "xsurf100";
+	info->version = DRV_VERSION;
+	info->irq = UIO_IRQ_NONE;
+
+	info->mem[0].name = "registers";
+	info->mem[0].addr = zdev->resource.start;
+	info->mem[0].size = PAGE_ALIGN(XS100_8390_BASE + 4*0x20);
+	info->mem[0].memtype = UIO_MEM_PHYS;
+	info->mem[0].internal_addr = ei_local->mem;
+
+	info->mem[1].name = "data32";
+	info->mem[1].addr = zdev->resource.start + XS100_8390_DATA32_BASE;
+	info->mem[1].size = XS100_8390_DATA32_SIZE;
+	info->mem[1].memtype = UIO_MEM_PHYS;
+	info->mem[1].internal_addr = ax->data_area;
+
+	ret = uio_register_device(&zdev->dev, info);
+	if (ret) {
+		kfree(info);
+		return ret;
+	}
+
+	ax->uio = info;
+	dev_info(&zdev->dev, "handed to userspace via UIO\n");
+	return 0;
+}
+
+static void xs100_uio_unregister(struct net_device *dev)
+{
+	struct ax_device *ax = to_ax_dev(dev);
+
+	uio_unregister_device(ax->uio);
+	kfree(ax->uio);
+	ax->uio = NULL;
+}
+#else
+#define uio_mode false
+
+static inline int xs100_uio_register(struct zorro_dev *zdev,
+				     struct net_device *dev)
+{
+	return -ENODEV;
+}
+
+static inline void xs100_uio_unregister(struct net_device *dev)
+{
+}
+#endif
+
+static void xs100_remove(struct zorro_dev *zdev)
+{
+	struct net_device *dev = zorro_get_drvdata(zdev);
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	if (uio_mode) {
+		xs100_uio_unregister(dev);
+	} else {
+		unregister_netdev(dev);
+		ax_debugfs_exit(dev);
+		ax_mii_remove(dev);
+	}
+
+	z_iounmap(to_ax_dev(dev)->data_area);
+	release_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
+	z_iounmap(ei_local->mem);
+	release_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20);
+
+	free_netdev(dev);
+}
+
+static const struct ax_plat_data xsurf100_plat_data = {
+	.flags = AXFLG_HAS_EEPROM,
+	.wordlength = 2,
+	.dcr_val = 0x48,
+	.rcr_val = 0x40,
+};
+
+/*
+ * xs100_probe
+ *
+ * This is the entry point when the Zorro bus code notifies us of a new
+ * X-Surf 100 to attach to. Allocate memory, find the resources and
+ * information passed, and map the necessary registers.
+ */
+static int xs100_probe(struct zorro_dev *zdev, const struct zorro_device_id *ent)
+{
+	struct net_device *dev;
+	struct ei_device *ei_local;
+	struct ax_device *ax;
+	int ret = 0;
+
+	dev = ax_alloc_dev(&zdev->dev, &xs100_bus_ops, &xsurf100_plat_data);
+	if (dev == NULL)
+		return -ENOMEM;
+
+	/* ok, let's setup our device */
+	ei_local = netdev_priv(dev);
+	ax = to_ax_dev(dev);
+
+	zorro_set_drvdata(zdev, dev);
+
+	dev->irq = IRQ_AMIGA_PORTS;
+	ax->irqflags = IRQF_SHARED;
+
+	if (!request_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20, "X-Surf 100 8390 registers")) {
+		dev_err(&zdev->dev, "cannot reserve registers\n");
+		ret = -ENXIO;
+		goto exit_mem;
+	}
+
+	ei_local->mem = z_ioremap(zdev->resource.start, XS100_8390_BASE + 4*0x20);
+	dev->base_addr = (unsigned long)ei_local->mem;
+
+	if (ei_local->mem == NULL) {
+		dev_err(&zdev->dev, "Cannot ioremap area %pR\n", (void*)zdev->resource.start);
+
+		ret = -ENXIO;
+		goto exit_req;
+	}
+
+	if (!request_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE, "X-Surf 100 32-bit data access")) {
+		dev_err(&zdev->dev, "cannot reserve 32-bit area\n");
+		ret = -ENXIO;
+		goto exit_mem2;
+	}
+
+	ax->data_area = z_ioremap(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
+
+	if(ax->data_area == NULL)
+	{
+		dev_err(&zdev->dev, "Cannot ioremap area %pR (32-bit access)\n", (void*)zdev->resource.start + XS100_8390_DATA32_BASE);
+
+		ret = -ENXIO;
+		goto exit_req2;
+	}
+
+	ax->xs100irqstatusreg = (char __iomem*)ei_local->mem + XS100_IRQSTATUS_BASE;
+	ax->xs100readfifo = ax->data_area + XS100_8390_DATA_READ32_BASE;
+	ax->xs100writefifo = ax->data_area + XS100_8390_DATA_WRITE32_BASE;
+
+	/* until ax_calibrate_copy() knows better */
+	ax->fifo_in[0] = ax->fifo_in[1] = ax_fifo_kernels[0].in;
+	ax->fifo_out[0] = ax->fifo_out[1] = ax_fifo_kernels[0].out;
+
+	/* got resources, now initialise and register device */
+	if (uio_mode)
+		ret = xs100_uio_register(zdev, dev);
+	else
+		ret = ax_init_dev(dev);
+	if (!ret)
+		return 0;
+
+	z_iounmap(ax->data_area);
+
+ exit_req2:
+	release_mem_region(zdev->resource.start + XS100_8390_DATA32_BASE, XS100_8390_DATA32_SIZE);
+
+ exit_mem2:
+	z_iounmap(ei_local->mem);
+
+ exit_req:
+	release_mem_region(zdev->resource.start, XS100_8390_BASE + 4*0x20);
+
+ exit_mem:
+	free_netdev(dev);
+
+	return ret;
+}
+
+#define ZORRO_PROD_INDIVIDUAL_COMPUTERS_X_SURF100 ZORRO_ID(INDIVIDUAL_COMPUTERS, 0x64, 0)
+static struct zorro_device_id xsurf100_zorro_tbl[] = {
+	{ ZORRO_PROD_INDIVIDUAL_COMPUTERS_X_SURF100, },
+	{ 0 }
+};
+MODULE_DEVICE_TABLE(zorro, xsurf100_zorro_tbl);
+
+static struct zorro_driver xsurf100_driver = {
+	.name		= "xsurf100",
+	.id_table	= xsurf100_zorro_tbl,
+	.probe		= xs100_probe,
+	.remove		= xs100_remove,
+	.driver		= {
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
+	},
+};
+#endif
+
+#ifdef AX_HAVE_PCI
+/*
+ * PCI front end for NE2000 clones such as the RTL8029 that QEMU emulates
+ * as ne2k_pci. This exists so the lib8390 data path can be exercised on
+ * ordinary hardware. There is no MII and no FIFO window: packet data goes
+ * through NE_DATAPORT with 32-bit string I/O.
+ */
+#define NE2K_PCI_IO_SIZE	0x20
+
+static u8 ne2k_pci_readb(const void __iomem *addr)
+{
+	return ioread8((void __iomem *)addr);
+}
+
+static void ne2k_pci_writeb(u8 val, void __iomem *addr)
+{
+	iowrite8(val, addr);
+}
+
+static void ne2k_pci_read(struct net_device *dev, void *dst, unsigned count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *port = ei_local->mem + NE_DATAPORT;
+
+	ioread32_rep(port, dst, count >> 2);
+	dst += count & ~3;
+	if (count & 2) {
+		ioread16_rep(port, dst, 1);
+		dst += 2;
+	}
+	if (count & 1)
+		*(u8 *)dst = ioread8(port);
+}
+
+static void ne2k_pci_write(struct net_device *dev, const void *src, unsigned count)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	void __iomem *port = ei_local->mem + NE_DATAPORT;
+
+	iowrite32_rep(port, src, count >> 2);
+	src += count & ~3;
+	if (count & 2) {
+		iowrite16_rep(port, src, 1);
+		src += 2;
+	}
+	if (count & 1)
+		iowrite8(*(const u8 *)src, port);
+}
+
+static const struct ax_bus_ops ne2k_pci_bus_ops = {
+	.name		= "pci",
+	.readb		= ne2k_pci_readb,
+	.writeb		= ne2k_pci_writeb,
+	.read_data	= ne2k_pci_read,
+	.write_data	= ne2k_pci_write,
+	.reg_base	= 0,
+	.reg_stride	= 1,
+	.has_mii	= false,
+};
+
+static const struct ax_plat_data ne2k_pci_plat_data = {
+	.flags = AXFLG_HAS_EEPROM,
+	.wordlength = 2,
+	.dcr_val = 0x49,
+	.rcr_val = 0x00,
+};
+
+static int ne2k_pci_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
+{
+	struct net_device *dev;
+	struct ei_device *ei_local;
+	void __iomem *ioaddr;
+	int ret;
+
+	ret = pci_enable_device(pdev);
+	if (ret)
+		return ret;
+
+	ret = pci_request_regions(pdev, DRV_NAME);
+	if (ret)
+		goto exit_disable;
+
+	ioaddr = pci_iomap(pdev, 0, NE2K_PCI_IO_SIZE);
+	if (ioaddr == NULL) {
+		dev_err(&pdev->dev, "cannot map registers\n");
+		ret = -ENXIO;
+		goto exit_release;
+	}
+
+	dev = ax_alloc_dev(&pdev->dev, &ne2k_pci_bus_ops, &ne2k_pci_plat_data);
+	if (dev == NULL) {
+		ret = -ENOMEM;
+		goto exit_unmap;
+	}
+
+	ei_local = netdev_priv(dev);
+	ei_local->mem = ioaddr;
+	dev->base_addr = (unsigned long)ioaddr;
+	dev->irq = pdev->irq;
+	to_ax_dev(dev)->irqflags = IRQF_SHARED;
+	pci_set_drvdata(pdev, dev);
+
+	ret = ax_init_dev(dev);
+	if (!ret)
+		return 0;
+
+	free_netdev(dev);
+ exit_unmap:
+	pci_iounmap(pdev, ioaddr);
+ exit_release:
+	pci_release_regions(pdev);
+ exit_disable:
+	pci_disable_device(pdev);
+	return ret;
+}
+
+static void ne2k_pci_remove(struct pci_dev *pdev)
+{
+	struct net_device *dev = pci_get_drvdata(pdev);
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	unregister_netdev(dev);
+	ax_debugfs_exit(dev);
+	pci_iounmap(pdev, ei_local->mem);
+	pci_release_regions(pdev);
+	pci_disable_device(pdev);
+	free_netdev(dev);
+}
+
+static const struct pci_device_id ne2k_pci_tbl[] = {
+	{ PCI_DEVICE(PCI_VENDOR_ID_REALTEK, 0x8029) },
+	{ 0 }
+};
+MODULE_DEVICE_TABLE(pci, ne2k_pci_tbl);
+
+static struct pci_driver ne2k_pci_driver = {
+	.name		= DRV_NAME,
+	.id_table	= ne2k_pci_tbl,
+	.probe		= ne2k_pci_probe,
+	.remove		= ne2k_pci_remove,
+	.driver		= {
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
+	},
+};
+#endif
+
+static int __init ax_init_module(void)
+{
+	int ret = 0;
+#ifdef CONFIG_AX88796_FAULT_INJECT
+	int i;
+#endif
+
+	ax_debugfs_root = debugfs_create_dir(DRV_NAME, NULL);
+#ifdef CONFIG_AX88796_PROFILE
+	debugfs_create_file("profile", S_IRUGO | S_IWUSR, ax_debugfs_root,
+			    NULL, &ax_prof_fops);
+#endif
+#ifdef CONFIG_AX88796_FAULT_INJECT
+	for (i = 0; i < EI_FAULT_NR; i++) {
+		char name[24];
+
+		snprintf(name, sizeof(name), "fail_%s", ax_fault_names[i]);
+		fault_create_debugfs_attr(name, ax_debugfs_root,
+					  &ax_fail_attr[i]);
+	}
+#endif
+
+#ifdef CONFIG_ZORRO
+	ret = zorro_register_driver(&xsurf100_driver);
+	if (ret)
+		goto out_debugfs;
+#endif
+#ifdef AX_HAVE_PCI
+	ret = pci_register_driver(&ne2k_pci_driver);
+	if (ret)
+		goto out_zorro;
+#endif
+	return 0;
+
+#ifdef AX_HAVE_PCI
+ out_zorro:
+#endif
+#ifdef CONFIG_ZORRO
+	zorro_unregister_driver(&xsurf100_driver);
+ out_debugfs:
+#endif
+	debugfs_remove_recursive(ax_debugfs_root);
+	return ret;
+}
+module_init(ax_init_module);
+
+static void __exit ax_exit_module(void)
+{
+#ifdef AX_HAVE_PCI
+	pci_unregister_driver(&ne2k_pci_driver);
+#endif
+#ifdef CONFIG_ZORRO
+	zorro_unregister_driver(&xsurf100_driver);
+#endif
+	debugfs_remove_recursive(ax_debugfs_root);
+}
+module_exit(ax_exit_module);
 
 MODULE_DESCRIPTION("X-Surf 100 driver");
 MODULE_AUTHOR("Michael Karcher <kernel@mkarcher.dialup.fu-berlin.de>");
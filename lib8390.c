@@ -67,9 +67,11 @@
 #include <linux/interrupt.h>
 #include <linux/init.h>
 #include <linux/crc32.h>
+#include <linux/workqueue.h>
 
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/pkt_sched.h>
 
 #define NS8390_CORE
 #include "8390.h"
@@ -82,10 +84,11 @@
 		Resets the board associated with DEV, including a hardware reset of
 		the 8390.  This is only called when there is a transmit timeout, and
 		it is always followed by 8390_init().
-	void block_output(struct net_device *dev, int count, const unsigned char *buf,
-					  int start_page)
+	int block_output(struct net_device *dev, int count, const unsigned char *buf,
+					 int start_page)
 		Write the COUNT bytes of BUF to the packet buffer at START_PAGE.  The
-		"page" value uses the 8390's 256-byte pages.
+		"page" value uses the 8390's 256-byte pages.  Returns non-zero if the
+		upload failed and the board was reset and reinitialised instead.
 	void get_8390_hdr(struct net_device *dev, struct e8390_hdr *hdr, int ring_page)
 		Read the 4 byte, page aligned 8390 header. *If* there is a
 		subsequent read, it will be of the rest of the packet.
@@ -94,10 +97,51 @@
 		reading from RING_OFFSET, the address as the 8390 sees it.  This will always
 		follow the read of the 8390 header.
 */
+#ifndef ei_block_output
 #define ei_reset_8390 (ei_local->reset_8390)
 #define ei_block_output (ei_local->block_output)
 #define ei_block_input (ei_local->block_input)
 #define ei_get_8390_hdr (ei_local->get_8390_hdr)
+#endif
+
+/* Boards with a fixed bus width may define these as constants. */
+#ifndef ei_word16
+#define ei_word16(ei_local) ((ei_local)->word16)
+#define ei_bigendian(ei_local) ((ei_local)->bigendian)
+#endif
+
+/* Called with each transmit status the board reports, lock held. */
+#ifndef ei_tx_status
+#define ei_tx_status(dev, txsr)	do { } while (0)
+#endif
+
+/* Optional instrumentation hooks, see enum ei_prof_op. */
+#ifndef ei_prof_begin
+#define ei_prof_begin(dev, op)	do { } while (0)
+#define ei_prof_end(dev, op)	do { } while (0)
+#endif
+
+/* Optional per-stage timing hooks, see enum ei_stage. */
+#ifndef ei_stage_clock
+#define ei_stage_clock(dev)		0
+#define ei_stage_add(dev, stage, t0)	((void)(t0))
+#endif
+
+/* Optional hooks timing interrupt-off sections, see enum ei_window. */
+#ifndef ei_window_begin
+#define ei_window_begin(dev)		0
+#define ei_window_end(dev, win, t0)	((void)(t0))
+#endif
+
+/*
+ * Optional hooks around the error recovery paths, see enum ei_fault.
+ * ei_fail() lets a board make the fault happen on purpose.
+ */
+#ifndef ei_fail
+#define ei_fail(dev, fault)		false
+#define ei_recover_begin(dev, fault)	do { } while (0)
+#define ei_recover_end(dev, fault)	do { } while (0)
+#endif
 
 /* use 0 for production, 1 for verification, >2 for debug */
 #ifndef ei_debug
@@ -105,10 +149,13 @@ int ei_debug = 1;
 #endif
 
 /* Index to functions. */
+static void ei_tx_work(struct work_struct *work);
 static void ei_tx_intr(struct net_device *dev);
 static void ei_tx_err(struct net_device *dev);
+static bool ei_tx_recover(struct net_device *dev, int level);
 static void ei_receive(struct net_device *dev);
 static void ei_rx_overrun(struct net_device *dev);
+static int ei_rx_fill(struct ei_device *ei_local, unsigned char curpag);
 
 /* Routines generic to NS8390-based boards. */
 static void NS8390_trigger_send(struct net_device *dev, unsigned int length,
@@ -213,9 +260,10 @@ static int __ei_open(struct net_device *dev)
 
 	spin_lock_irqsave(&ei_local->page_lock, flags);
 	__NS8390_init(dev, 1);
+	ei_local->tx_reserve_until = jiffies;
 	/* Set the flag before we drop the lock, That way the IRQ arrives
 	   after its set and we get no silly warnings */
-	netif_start_queue(dev);
+	netif_tx_start_all_queues(dev);
 	spin_unlock_irqrestore(&ei_local->page_lock, flags);
 	ei_local->irqlock = 0;
 	return 0;
@@ -231,6 +279,17 @@ static int __ei_close(struct net_device *dev)
 {
 	struct ei_device *ei_local = netdev_priv(dev);
 	unsigned long flags;
+	int q;
+
+	/*
+	 * Stop the Tx worker before the chip, so it cannot upload or
+	 * trigger a send while, or after, the card is being stopped. With
+	 * nothing staged, ei_tx_intr() has no reason to requeue it.
+	 */
+	netif_tx_stop_all_queues(dev);
+	cancel_work_sync(&ei_local->tx_work);
+	for (q = 0; q < EI_TX_QUEUES; q++)
+		skb_queue_purge(&ei_local->tx_stage[q]);
 
 	/*
 	 *	Hold the page lock during close
@@ -239,7 +298,6 @@ static int __ei_close(struct net_device *dev)
 	spin_lock_irqsave(&ei_local->page_lock, flags);
 	__NS8390_init(dev, 0);
 	spin_unlock_irqrestore(&ei_local->page_lock, flags);
-	netif_stop_queue(dev);
 	return 0;
 }
 
@@ -257,7 +315,10 @@ static void __ei_tx_timeout(struct net_device *dev)
 	struct ei_device *ei_local = netdev_priv(dev);
 	int txsr, isr, tickssofar = jiffies - dev_trans_start(dev);
 	unsigned long flags;
+	int level;
+	u64 t0;
 
+	ei_recover_begin(dev, EI_FAULT_TX_TIMEOUT);
 	dev->stats.tx_errors++;
 
 	spin_lock_irqsave(&ei_local->page_lock, flags);
@@ -277,62 +338,285 @@ static void __ei_tx_timeout(struct net_device *dev)
 
 	/* Ugly but a reset can be slow, yet must be protected */
 
+	t0 = ei_window_begin(dev);
 	disable_irq_nosync_lockdep(dev->irq);
 	spin_lock(&ei_local->page_lock);
 
-	/* Try to restart the card.  Perhaps the user has fixed something. */
-	ei_reset_8390(dev);
-	__NS8390_init(dev, 1);
+	/* Escalate one level per consecutive timeout; a sent frame resets it. */
+	level = ei_local->tx_recover_level;
+	if (level < EI_TXREC_RESET)
+		ei_local->tx_recover_level++;
+
+	if (level == EI_TXREC_RESET || !ei_tx_recover(dev, level)) {
+		/* Try to restart the card.  Perhaps the user has fixed something. */
+		level = EI_TXREC_RESET;
+		ei_recover_begin(dev, EI_FAULT_RESET);
+		ei_reset_8390(dev);
+		__NS8390_init(dev, 1);
+		ei_recover_end(dev, EI_FAULT_RESET);
+		ei_local->tx_recover_level = 0;
+	}
+	ei_local->tx_recover[level]++;
 
 	spin_unlock(&ei_local->page_lock);
 	enable_irq_lockdep(dev->irq);
-	netif_wake_queue(dev);
+	ei_window_end(dev, EI_WIN_TIMEOUT, t0);
+	ei_recover_end(dev, EI_FAULT_TX_TIMEOUT);
+	netif_tx_wake_all_queues(dev);
+	queue_work(system_highpri_wq, &ei_local->tx_work);
 }
 
 /**
- * ei_start_xmit - begin packet transmission
- * @skb: packet to be sent
- * @dev: network device to which packet is sent
+ * ei_tx_recover - try to unstick the transmitter without a reset
+ * @dev: network device
+ * @level: EI_TXREC_RETRY or EI_TXREC_ABORT
  *
- * Sends a packet to an 8390 network device.
+ * Returns false if the transmitter could not be freed this way and the
+ * caller has to reset the chip. The receiver is never stopped, so the
+ * Rx ring and the multicast filter survive. Called with the lock held
+ * and the IRQ disabled.
  */
 
-static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
-				   struct net_device *dev)
+static bool ei_tx_recover(struct net_device *dev, int level)
 {
 	unsigned long e8390_base = dev->base_addr;
 	struct ei_device *ei_local = netdev_priv(dev);
-	int send_length = skb->len, output_page;
-	unsigned long flags;
-	char buf[ETH_ZLEN];
-	char *data = skb->data;
+	int isr, tsr, i;
 
-	if (skb->len < ETH_ZLEN) {
-		memset(buf, 0, ETH_ZLEN);	/* more efficient than doing just the needed bits */
-		memcpy(buf, data, skb->len);
-		send_length = ETH_ZLEN;
-		data = buf;
+	if (!ei_local->txing)
+		return false;
+
+	ei_outb_p(E8390_NODMA+E8390_PAGE0, e8390_base + E8390_CMD);
+	isr = ei_inb_p(e8390_base + EN0_ISR);
+
+	/* Unmask what an injected fault hid from ei_interrupt(). */
+	if (ei_local->isr_lost) {
+		ei_local->isr_lost = 0;
+		ei_outb_p(ENISR_ALL, e8390_base + EN0_IMR);
 	}
 
+	/* The frame went out; only its interrupt got lost. */
+	if (isr & ENISR_TX_ERR) {
+		ei_tx_err(dev);
+		return true;
+	}
+	if (isr & ENISR_TX) {
+		ei_outb_p(ENISR_TX, e8390_base + EN0_ISR);
+		ei_tx_intr(dev);
+		return true;
+	}
+
+	if (level == EI_TXREC_RETRY) {
+		if (ei_inb_p(e8390_base + E8390_CMD) & E8390_TRANS)
+			return true;
+
+		/*
+		 * The transmitter is done but ISR has no record of it. If
+		 * TSR says the frame went out or was aborted, complete the
+		 * slot rather than putting the frame on the wire twice.
+		 */
+		tsr = ei_inb_p(e8390_base + EN0_TSR);
+		if (tsr & ENTSR_ABT) {
+			ei_tx_err(dev);
+			return true;
+		}
+		if (tsr & ENTSR_PTX) {
+			ei_tx_intr(dev);
+			return true;
+		}
+
+		/* TPSR and TBCR still describe the frame: send it again. */
+		ei_outb_p(E8390_NODMA+E8390_TRANS+E8390_START,
+			  e8390_base + E8390_CMD);
+		return true;
+	}
+
+	/* Finish the stuck send into internal loopback, then drop it. */
+	ei_outb_p(E8390_TXOFF, e8390_base + EN0_TXCR);
+	for (i = 0; i < 100 && (ei_inb_p(e8390_base + E8390_CMD) & E8390_TRANS); i++)
+		udelay(10);
+	ei_outb_p(E8390_TXCONFIG, e8390_base + EN0_TXCR);
+
+	if (ei_inb_p(e8390_base + E8390_CMD) & E8390_TRANS)
+		return false;
+
+	ei_outb_p(ENISR_TX | ENISR_TX_ERR, e8390_base + EN0_ISR);
+	ei_tx_intr(dev);
+	return true;
+}
+
+/*
+ * Pages of the receive ring holding frames we have not read yet: from our
+ * read pointer up to the chip's write pointer CURPAG.
+ */
+static int ei_rx_fill(struct ei_device *ei_local, unsigned char curpag)
+{
+	int num_rx_pages = ei_local->stop_page - ei_local->rx_start_page;
+
+	return (curpag - ei_local->current_page + num_rx_pages) % num_rx_pages;
+}
+
+/*
+ * Called with the card claimed. If the receive ring overran, run the
+ * overrun recovery; if it is above its high watermark, empty it. Either
+ * way before spending more bus time on uploads, rather than waiting for
+ * the interrupt handler. Returns 1 if it did.
+ *
+ * The check costs an ISR read, two page switches and a CURPAG read, so
+ * it runs once per ei_tx_claim() burst, and again before the next frame
+ * or chunk only while the previous one found work to do.
+ */
+static int ei_tx_make_room(struct net_device *dev)
+{
+	unsigned long e8390_base = dev->base_addr;
+	struct ei_device *ei_local = netdev_priv(dev);
+	unsigned char curpag;
+
+	if (!ei_local->rx_check)
+		return 0;
+	ei_local->rx_check = 0;
+
+	if (ei_inb_p(e8390_base + EN0_ISR) & ENISR_OVER) {
+		/* the receiver has stopped, only the full restart revives it */
+		ei_local->rx_drain_tx++;
+		ei_rx_overrun(dev);
+		ei_local->rx_check = 1;
+		return 1;
+	}
+
+	if (!ei_local->rx_high_water)
+		return 0;
+
+	ei_outb_p(E8390_NODMA+E8390_PAGE1, e8390_base + E8390_CMD);
+	curpag = ei_inb_p(e8390_base + EN1_CURPAG);
+	ei_outb_p(E8390_NODMA+E8390_PAGE0, e8390_base + E8390_CMD);
+
+	if (ei_rx_fill(ei_local, curpag) < ei_local->rx_high_water)
+		return 0;
+
+	ei_local->rx_drain_tx++;
+	ei_receive(dev);
+	ei_local->rx_check = 1;
+	return 1;
+}
+
+/**
+ * ei_tx_claim - take the card for a burst of uploads
+ * @dev: network device
+ * @flags: saved interrupt state, handed back to ei_tx_release()
+ *
+ * Masks the 8390's interrupts and keeps the IRQ line and page_lock held
+ * until ei_tx_release(), so any number of ei_tx_upload() calls in between
+ * pay for the setup only once.
+ */
+
+static void ei_tx_claim(struct net_device *dev, unsigned long *flags)
+{
+	unsigned long e8390_base = dev->base_addr;
+	struct ei_device *ei_local = netdev_priv(dev);
+
 	/* Mask interrupts from the ethercard.
 	   SMP: We have to grab the lock here otherwise the IRQ handler
 	   on another CPU can flip window and race the IRQ mask set. We end
 	   up trashing the mcast filter not disabling irqs if we don't lock */
 
-	spin_lock_irqsave(&ei_local->page_lock, flags);
+	spin_lock_irqsave(&ei_local->page_lock, *flags);
 	ei_outb_p(0x00, e8390_base + EN0_IMR);
-	spin_unlock_irqrestore(&ei_local->page_lock, flags);
+	spin_unlock_irqrestore(&ei_local->page_lock, *flags);
 
 
 	/*
 	 *	Slow phase with lock held.
 	 */
 
-	disable_irq_nosync_lockdep_irqsave(dev->irq, &flags);
+	disable_irq_nosync_lockdep_irqsave(dev->irq, flags);
 
 	spin_lock(&ei_local->page_lock);
 
 	ei_local->irqlock = 1;
+	ei_local->rx_check = 1;
+}
+
+static void ei_tx_release(struct net_device *dev, unsigned long *flags)
+{
+	unsigned long e8390_base = dev->base_addr;
+	struct ei_device *ei_local = netdev_priv(dev);
+
+	/* Turn 8390 interrupts back on. */
+	ei_local->irqlock = 0;
+	ei_outb_p(ENISR_ALL & ~ei_local->isr_lost, e8390_base + EN0_IMR);
+
+	spin_unlock(&ei_local->page_lock);
+	enable_irq_lockdep_irqrestore(dev->irq, flags);
+}
+
+/*
+ * A frame asking for a software Tx timestamp stays in ei_local->tx_skb[]
+ * while it is on the card, so ei_tx_intr() can stamp it when the
+ * transmitter reports it sent rather than when it was uploaded.
+ */
+static bool ei_tx_stamped(struct sk_buff *skb)
+{
+	return skb_shinfo(skb)->tx_flags & SKBTX_SW_TSTAMP;
+}
+
+/* Release the frame held for Tx slot @slot, stamping it if it went out. */
+static void ei_tx_complete(struct ei_device *ei_local, int slot, int status)
+{
+	struct sk_buff *skb = ei_local->tx_skb[slot];
+
+	if (!skb)
+		return;
+
+	ei_local->tx_skb[slot] = NULL;
+	if ((status & ENTSR_PTX) &&
+	    !(skb_shinfo(skb)->tx_flags & SKBTX_IN_PROGRESS))
+		skb_tstamp_tx(skb, NULL);
+	dev_kfree_skb_any(skb);
+}
+
+/**
+ * ei_tx_upload - copy one staged packet into a free Tx slot
+ * @dev: network device to which packet is sent
+ * @skb: packet to be sent
+ * @q: Tx queue @skb was staged on
+ *
+ * Uploads @skb into whichever Tx slot is free and triggers the send if the
+ * transmitter is idle. Returns NETDEV_TX_BUSY, leaving the packet alone, when
+ * both slots are still occupied, or, with tx_reserve set, when a bulk packet
+ * would take the last free slot within TX_RESERVE_HOLD of a priority one.
+ * A packet whose upload failed is counted as a Tx error and dropped.
+ * Called from the Tx worker only, with the card claimed by ei_tx_claim().
+ * A packet wanting a software timestamp is parked in ei_local->tx_skb[]
+ * and then belongs to the Tx interrupt path.
+ */
+
+static netdev_tx_t ei_tx_upload(struct net_device *dev, struct sk_buff *skb,
+				int q)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	int send_length = skb->len, output_page;
+	char buf[ETH_ZLEN];
+	char *data = skb->data;
+	u64 t0;
+
+	if (skb->len < ETH_ZLEN) {
+		memset(buf, 0, ETH_ZLEN);	/* more efficient than doing just the needed bits */
+		memcpy(buf, data, skb->len);
+		send_length = ETH_ZLEN;
+		data = buf;
+	}
+
+	/* While priority traffic is about, bulk may only use an idle card,
+	   so a priority frame never waits behind more than the one bulk
+	   frame on the wire. Otherwise bulk gets both slots. */
+	if (q == EI_TXQ_PRIO)
+		ei_local->tx_reserve_until = jiffies + TX_RESERVE_HOLD;
+	else if (ei_local->tx_reserve && (ei_local->tx1 || ei_local->tx2) &&
+		 time_before(jiffies, ei_local->tx_reserve_until))
+		return NETDEV_TX_BUSY;
+
+	ei_prof_begin(dev, EI_PROF_TX);
 
 	/*
 	 * We have two Tx slots available for use. Find the first free
@@ -354,16 +638,9 @@ static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
 		if (ei_debug  &&  ei_local->tx1 > 0)
 			netdev_dbg(dev, "idle transmitter, tx1=%d, lasttx=%d, txing=%d\n",
 				   ei_local->tx1, ei_local->lasttx, ei_local->txing);
-	} else {			/* We should never get here. */
-		if (ei_debug)
-			netdev_dbg(dev, "No Tx buffers free! tx1=%d tx2=%d last=%d\n",
-				   ei_local->tx1, ei_local->tx2, ei_local->lasttx);
-		ei_local->irqlock = 0;
-		netif_stop_queue(dev);
-		ei_outb_p(ENISR_ALL, e8390_base + EN0_IMR);
-		spin_unlock(&ei_local->page_lock);
-		enable_irq_lockdep_irqrestore(dev->irq, &flags);
-		dev->stats.tx_errors++;
+	} else {
+		/* Both slots busy; ei_tx_intr() reschedules us once one drains. */
+		ei_prof_end(dev, EI_PROF_TX);
 		return NETDEV_TX_BUSY;
 	}
 
@@ -373,11 +650,24 @@ static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
 	 * trigger the send later, upon receiving a Tx done interrupt.
 	 */
 
-	ei_block_output(dev, send_length, data, output_page);
+	t0 = ei_stage_clock(dev);
+	if (ei_block_output(dev, send_length, data, output_page)) {
+		/* The card was reset: both slots are free and nothing is sending. */
+		dev->stats.tx_errors++;
+		ei_prof_end(dev, EI_PROF_TX);
+		return NETDEV_TX_OK;
+	}
+	ei_stage_add(dev, EI_STAGE_UPLOAD, t0);
+
+	/* Only now: a failed upload resets the card, dropping held frames. */
+	if (ei_tx_stamped(skb))
+		ei_local->tx_skb[output_page != ei_local->tx_start_page] = skb;
 
 	if (!ei_local->txing) {
 		ei_local->txing = 1;
+		t0 = ei_stage_clock(dev);
 		NS8390_trigger_send(dev, send_length, output_page);
+		ei_stage_add(dev, EI_STAGE_TRIGGER, t0);
 		if (output_page == ei_local->tx_start_page) {
 			ei_local->tx1 = -1;
 			ei_local->lasttx = -1;
@@ -388,20 +678,114 @@ static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
 	} else
 		ei_local->txqueue++;
 
-	if (ei_local->tx1  &&  ei_local->tx2)
-		netif_stop_queue(dev);
-	else
-		netif_start_queue(dev);
+	ei_prof_end(dev, EI_PROF_TX);
+	dev->stats.tx_bytes += send_length;
 
-	/* Turn 8390 interrupts back on. */
-	ei_local->irqlock = 0;
-	ei_outb_p(ENISR_ALL, e8390_base + EN0_IMR);
+	return NETDEV_TX_OK;
+}
 
-	spin_unlock(&ei_local->page_lock);
-	enable_irq_lockdep_irqrestore(dev->irq, &flags);
-	skb_tx_timestamp(skb);
-	dev_kfree_skb(skb);
-	dev->stats.tx_bytes += send_length;
+static bool ei_tx_staged(struct ei_device *ei_local)
+{
+	return !skb_queue_empty(&ei_local->tx_stage[EI_TXQ_PRIO]) ||
+	       !skb_queue_empty(&ei_local->tx_stage[EI_TXQ_BULK]);
+}
+
+/* next staged packet, priority queue first */
+static struct sk_buff *ei_tx_next(struct ei_device *ei_local, int *q)
+{
+	struct sk_buff *skb;
+
+	*q = EI_TXQ_PRIO;
+	skb = skb_peek(&ei_local->tx_stage[EI_TXQ_PRIO]);
+	if (skb)
+		return skb;
+
+	*q = EI_TXQ_BULK;
+	return skb_peek(&ei_local->tx_stage[EI_TXQ_BULK]);
+}
+
+/**
+ * ei_tx_work - drain the Tx staging queues
+ * @work: the tx_work member of the board's ei_device
+ *
+ * Moves staged packets onto the card, priority queue first, for as long
+ * as there is a Tx slot they may use. The slow PIO upload therefore
+ * runs here instead of in the context of whoever called ndo_start_xmit,
+ * and ei_tx_intr() can start the next upload as soon as the transmitter
+ * frees a slot. The card is claimed once for the whole batch; uploaded
+ * packets are freed after it has been released again.
+ */
+
+static void ei_tx_work(struct work_struct *work)
+{
+	struct ei_device *ei_local = container_of(work, struct ei_device, tx_work);
+	struct net_device *dev = ei_local->dev;
+	struct sk_buff_head done;
+	struct sk_buff *skb;
+	unsigned long flags;
+	int q;
+	u64 t0;
+
+	__skb_queue_head_init(&done);
+
+	/* ei_tx_make_room() may hand frames to netif_rx() */
+	local_bh_disable();
+	if (netif_running(dev) && ei_tx_staged(ei_local)) {
+		t0 = ei_window_begin(dev);
+		ei_tx_claim(dev, &flags);
+		while (netif_running(dev) &&
+		       (skb = ei_tx_next(ei_local, &q)) != NULL) {
+			ei_tx_make_room(dev);
+			if (ei_tx_upload(dev, skb, q) != NETDEV_TX_OK)
+				break;
+			skb_unlink(skb, &ei_local->tx_stage[q]);
+			if (ei_local->tx_skb[0] == skb ||
+			    ei_local->tx_skb[1] == skb) {
+				/* ei_tx_intr() stamps and frees it */
+				skb_clone_tx_timestamp(skb);
+				continue;
+			}
+			skb_tx_timestamp(skb);
+			__skb_queue_tail(&done, skb);
+		}
+		ei_tx_release(dev, &flags);
+		ei_window_end(dev, EI_WIN_TX, t0);
+	}
+	local_bh_enable();
+
+	while ((skb = __skb_dequeue(&done)) != NULL)
+		dev_kfree_skb(skb);
+
+	for (q = 0; q < EI_TX_QUEUES; q++)
+		if (skb_queue_len(&ei_local->tx_stage[q]) < TX_STAGE_LEN)
+			netif_wake_subqueue(dev, q);
+}
+
+/**
+ * ei_start_xmit - begin packet transmission
+ * @skb: packet to be sent
+ * @dev: network device to which packet is sent
+ *
+ * Queues a packet for an 8390 network device. The upload to the card is
+ * done by ei_tx_work(). While the stack says more packets follow, the
+ * worker is not kicked, so it can upload the whole burst in one go.
+ */
+
+static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
+				   struct net_device *dev)
+{
+	struct ei_device *ei_local = netdev_priv(dev);
+	u16 q = skb_get_queue_mapping(skb);
+	bool more = skb->xmit_more;
+
+	skb_queue_tail(&ei_local->tx_stage[q], skb);
+	if (skb_queue_len(&ei_local->tx_stage[q]) >= TX_STAGE_LEN) {
+		netif_stop_subqueue(dev, q);
+		more = false;
+	}
+
+	if (!more)
+		queue_work(system_highpri_wq, &ei_local->tx_work);
 
 	return NETDEV_TX_OK;
 }
@@ -415,7 +799,8 @@ static netdev_tx_t __ei_start_xmit(struct sk_buff *skb,
  * the 8390 via the card specific functions and fire them at the networking
  * stack. We also handle transmit completions and wake the transmit path if
  * necessary. We also update the counters and do other housekeeping as
- * needed.
+ * needed. A board wrapper may set ei_local->rx_stamp before calling us, to
+ * timestamp received frames at interrupt entry; it is cleared on return.
  */
 
 static irqreturn_t __ei_interrupt(int irq, void *dev_id)
@@ -424,6 +809,8 @@ static irqreturn_t __ei_interrupt(int irq, void *dev_id)
 	unsigned long e8390_base = dev->base_addr;
 	int interrupts, nr_serviced = 0;
 	struct ei_device *ei_local = netdev_priv(dev);
+	u64 t0 = ei_stage_clock(dev);
+	u64 w0 = ei_window_begin(dev);
 
 	/*
 	 *	Protect the irq test too.
@@ -439,6 +826,7 @@ static irqreturn_t __ei_interrupt(int irq, void *dev_id)
 		netdev_err(dev, "Interrupted while interrupts are masked! isr=%#2x imr=%#2x\n",
 			   ei_inb_p(e8390_base + EN0_ISR),
 			   ei_inb_p(e8390_base + EN0_IMR));
+		ei_local->rx_stamp = ns_to_ktime(0);
 		spin_unlock(&ei_local->page_lock);
 		return IRQ_NONE;
 	}
@@ -450,7 +838,8 @@ static irqreturn_t __ei_interrupt(int irq, void *dev_id)
 			   ei_inb_p(e8390_base + EN0_ISR));
 
 	/* !!Assumption!! -- we stay in page 0.	 Don't break this. */
-	while ((interrupts = ei_inb_p(e8390_base + EN0_ISR)) != 0 &&
+	while ((interrupts = ei_inb_p(e8390_base + EN0_ISR) &
+			     ~ei_local->isr_lost) != 0 &&
 	       ++nr_serviced < MAX_SERVICE) {
 		if (!netif_running(dev)) {
 			netdev_warn(dev, "interrupt from stopped card\n");
@@ -459,16 +848,24 @@ static irqreturn_t __ei_interrupt(int irq, void *dev_id)
 			interrupts = 0;
 			break;
 		}
-		if (interrupts & ENISR_OVER)
+		if ((interrupts & ENISR_OVER) ||
+		    ei_fail(dev, EI_FAULT_RX_OVERRUN))
 			ei_rx_overrun(dev);
 		else if (interrupts & (ENISR_RX+ENISR_RX_ERR)) {
 			/* Got a good (?) packet. */
 			ei_receive(dev);
 		}
 		/* Push the next to-transmit packet through. */
-		if (interrupts & ENISR_TX)
-			ei_tx_intr(dev);
-		else if (interrupts & ENISR_TX_ERR)
+		if (interrupts & ENISR_TX) {
+			if (ei_fail(dev, EI_FAULT_TX_TIMEOUT)) {
+				/* lose the interrupt: the completion stays
+				   in ISR, masked, for the watchdog to find */
+				ei_local->isr_lost |= ENISR_TX;
+				ei_outb_p(ENISR_ALL & ~ei_local->isr_lost,
+					  e8390_base + EN0_IMR);
+			} else
+				ei_tx_intr(dev);
+		} else if (interrupts & ENISR_TX_ERR)
 			ei_tx_err(dev);
 
 		if (interrupts & ENISR_COUNTERS) {
@@ -498,6 +895,9 @@ static irqreturn_t __ei_interrupt(int irq, void *dev_id)
 			ei_outb_p(0xff, e8390_base + EN0_ISR); /* Ack. all intrs. */
 		}
 	}
+	ei_local->rx_stamp = ns_to_ktime(0);
+	ei_stage_add(dev, EI_STAGE_IRQ, t0);
+	ei_window_end(dev, EI_WIN_HARDIRQ, w0);
 	spin_unlock(&ei_local->page_lock);
 	return IRQ_RETVAL(nr_serviced > 0);
 }
@@ -553,6 +953,7 @@ static void ei_tx_err(struct net_device *dev)
 	if (tx_was_aborted)
 		ei_tx_intr(dev);
 	else {
+		ei_tx_status(dev, txsr);
 		dev->stats.tx_errors++;
 		if (txsr & ENTSR_CRS)
 			dev->stats.tx_carrier_errors++;
@@ -568,7 +969,8 @@ static void ei_tx_err(struct net_device *dev)
  * @dev: network device for which tx intr is handled
  *
  * We have finished a transmit: check for errors and then trigger the next
- * packet to be sent. Called with lock held.
+ * packet to be sent. A frame held for a software timestamp gets it here,
+ * once ENTSR_PTX says it is on the wire. Called with lock held.
  */
 
 static void ei_tx_intr(struct net_device *dev)
@@ -576,6 +978,7 @@ static void ei_tx_intr(struct net_device *dev)
 	unsigned long e8390_base = dev->base_addr;
 	struct ei_device *ei_local = netdev_priv(dev);
 	int status = ei_inb(e8390_base + EN0_TSR);
+	int slot = -1;
 
 	ei_outb_p(ENISR_TX, e8390_base + EN0_ISR); /* Ack intr. */
 
@@ -590,6 +993,7 @@ static void ei_tx_intr(struct net_device *dev)
 			pr_err("%s: bogus last_tx_buffer %d, tx1=%d\n",
 			       ei_local->name, ei_local->lasttx, ei_local->tx1);
 		ei_local->tx1 = 0;
+		slot = 0;
 		if (ei_local->tx2 > 0) {
 			ei_local->txing = 1;
 			NS8390_trigger_send(dev, ei_local->tx2, ei_local->tx_start_page + 6);
@@ -603,6 +1007,7 @@ static void ei_tx_intr(struct net_device *dev)
 			pr_err("%s: bogus last_tx_buffer %d, tx2=%d\n",
 			       ei_local->name, ei_local->lasttx, ei_local->tx2);
 		ei_local->tx2 = 0;
+		slot = 1;
 		if (ei_local->tx1 > 0) {
 			ei_local->txing = 1;
 			NS8390_trigger_send(dev, ei_local->tx1, ei_local->tx_start_page);
@@ -616,7 +1021,15 @@ static void ei_tx_intr(struct net_device *dev)
 			    ei_local->lasttx);
 */
 
-	/* Minimize Tx latency: update the statistics after we restart TXing. */
+	/*
+	 * Minimize Tx latency: stamp and update the statistics after we
+	 * restart TXing.
+	 */
+	if (slot >= 0)
+		ei_tx_complete(ei_local, slot, status);
+	ei_tx_status(dev, status);
+	if (status & ENTSR_PTX)
+		ei_local->tx_recover_level = 0;
 	if (status & ENTSR_COL)
 		dev->stats.collisions++;
 	if (status & ENTSR_PTX)
@@ -636,14 +1049,21 @@ static void ei_tx_intr(struct net_device *dev)
 		if (status & ENTSR_OWC)
 			dev->stats.tx_window_errors++;
 	}
-	netif_wake_queue(dev);
+
+	/* A slot is free again: let the worker upload the next staged frame. */
+	if (ei_tx_staged(ei_local))
+		queue_work(system_highpri_wq, &ei_local->tx_work);
+	else
+		netif_tx_wake_all_queues(dev);
 }
 
 /**
  * ei_receive - receive some packets
  * @dev: network device with which receive will be run
  *
- * We have a good packet(s), get it/them out of the buffers.
+ * We have a good packet(s), get it/them out of the buffers. Frames get
+ * ei_local->rx_stamp as their timestamp when we run from the interrupt
+ * handler; otherwise the stack stamps them in netif_rx().
  * Called with lock held.
  */
 
@@ -656,6 +1076,7 @@ static void ei_receive(struct net_device *dev)
 	int rx_pkt_count = 0;
 	struct e8390_pkt_hdr rx_frame;
 	int num_rx_pages = ei_local->stop_page-ei_local->rx_start_page;
+	u64 t0;
 
 	while (++rx_pkt_count < 10) {
 		int pkt_len, pkt_stat;
@@ -674,25 +1095,41 @@ static void ei_receive(struct net_device *dev)
 		   (There is at least one clone claimed to have a problem.)
 
 		   Keep quiet if it looks like a card removal. One problem here
-		   is that some clones crash in roughly the same way.
+		   is that some clones crash in roughly the same way. Either way
+		   BOUNDARY is what the chip goes by, so follow it.
 		 */
-		if (ei_debug > 0 &&
-		    this_frame != ei_local->current_page &&
-		    (this_frame != 0x0 || rxing_page != 0xFF))
-			netdev_err(dev, "mismatched read page pointers %2x vs %2x\n",
-				   this_frame, ei_local->current_page);
+		if (this_frame != ei_local->current_page &&
+		    (this_frame != 0x0 || rxing_page != 0xFF)) {
+			ei_recover_begin(dev, EI_FAULT_RX_PAGE);
+			if (ei_debug > 0)
+				netdev_err(dev, "mismatched read page pointers %2x vs %2x\n",
+					   this_frame, ei_local->current_page);
+			ei_local->current_page = this_frame;
+			ei_recover_end(dev, EI_FAULT_RX_PAGE);
+		}
+
+		if (rx_pkt_count == 1)
+			ei_local->rx_fill[ei_rx_fill(ei_local, rxing_page) *
+					  EI_RX_FILL_NR / num_rx_pages]++;
 
 		if (this_frame == rxing_page)	/* Read all the frames? */
 			break;				/* Done for now */
 
+		ei_prof_begin(dev, EI_PROF_RX);
 		current_offset = this_frame << 8;
+		t0 = ei_stage_clock(dev);
 		ei_get_8390_hdr(dev, &rx_frame, this_frame);
+		ei_stage_add(dev, EI_STAGE_HDR, t0);
 
 		pkt_len = rx_frame.count - sizeof(struct e8390_pkt_hdr);
 		pkt_stat = rx_frame.status;
 
 		next_frame = this_frame + 1 + ((pkt_len+4)>>8);
 
+		/* a header whose link does not follow from its length */
+		if (ei_fail(dev, EI_FAULT_RX_PAGE))
+			rx_frame.next = next_frame + 2;
+
 		/* Check for bogosity warned by 3c503 book: the status byte is never
 		   written.  This happened a lot during testing! This code should be
 		   cleaned up someday. */
@@ -700,42 +1137,58 @@ static void ei_receive(struct net_device *dev)
 		    rx_frame.next != next_frame + 1 &&
 		    rx_frame.next != next_frame - num_rx_pages &&
 		    rx_frame.next != next_frame + 1 - num_rx_pages) {
+			ei_recover_begin(dev, EI_FAULT_RX_PAGE);
 			ei_local->current_page = rxing_page;
 			ei_outb(ei_local->current_page-1, e8390_base+EN0_BOUNDARY);
 			dev->stats.rx_errors++;
+			ei_recover_end(dev, EI_FAULT_RX_PAGE);
+			ei_prof_end(dev, EI_PROF_RX);
 			continue;
 		}
 
 		if (pkt_len < 60  ||  pkt_len > 1518) {
+			ei_recover_begin(dev, EI_FAULT_RX_BOGUS);
 			if (ei_debug)
 				netdev_dbg(dev, "bogus packet size: %d, status=%#2x nxpg=%#2x\n",
 					   rx_frame.count, rx_frame.status,
 					   rx_frame.next);
 			dev->stats.rx_errors++;
 			dev->stats.rx_length_errors++;
-		} else if ((pkt_stat & 0x0F) == ENRSR_RXOK) {
+			ei_recover_end(dev, EI_FAULT_RX_BOGUS);
+		} else if ((pkt_stat & 0x0F) == ENRSR_RXOK &&
+			   !ei_fail(dev, EI_FAULT_RX_BOGUS)) {
 			struct sk_buff *skb;
 
+			t0 = ei_stage_clock(dev);
 			skb = netdev_alloc_skb(dev, pkt_len + 2);
+			ei_stage_add(dev, EI_STAGE_ALLOC, t0);
 			if (skb == NULL) {
 				if (ei_debug > 1)
 					netdev_dbg(dev, "Couldn't allocate a sk_buff of size %d\n",
 						   pkt_len);
 				dev->stats.rx_dropped++;
+				ei_prof_end(dev, EI_PROF_RX);
 				break;
 			} else {
 				skb_reserve(skb, 2);	/* IP headers on 16 byte boundaries */
 				skb_put(skb, pkt_len);	/* Make room */
+				t0 = ei_stage_clock(dev);
 				ei_block_input(dev, pkt_len, skb, current_offset + sizeof(rx_frame));
+				ei_stage_add(dev, EI_STAGE_RX_COPY, t0);
 				skb->protocol = eth_type_trans(skb, dev);
+				if (ktime_to_ns(ei_local->rx_stamp))
+					skb->tstamp = ei_local->rx_stamp;
+				t0 = ei_stage_clock(dev);
 				if (!skb_defer_rx_timestamp(skb))
 					netif_rx(skb);
+				ei_stage_add(dev, EI_STAGE_NETIF_RX, t0);
 				dev->stats.rx_packets++;
 				dev->stats.rx_bytes += pkt_len;
 				if (pkt_stat & ENRSR_PHY)
 					dev->stats.multicast++;
 			}
 		} else {
+			ei_recover_begin(dev, EI_FAULT_RX_BOGUS);
 			if (ei_debug)
 				netdev_dbg(dev, "bogus packet: status=%#2x nxpg=%#2x size=%d\n",
 					   rx_frame.status, rx_frame.next,
@@ -744,6 +1197,7 @@ static void ei_receive(struct net_device *dev)
 			/* NB: The NIC counts CRC, frame and missed errors. */
 			if (pkt_stat & ENRSR_FO)
 				dev->stats.rx_fifo_errors++;
+			ei_recover_end(dev, EI_FAULT_RX_BOGUS);
 		}
 		next_frame = rx_frame.next;
 
@@ -755,6 +1209,7 @@ static void ei_receive(struct net_device *dev)
 		}
 		ei_local->current_page = next_frame;
 		ei_outb_p(next_frame-1, e8390_base+EN0_BOUNDARY);
+		ei_prof_end(dev, EI_PROF_RX);
 	}
 
 	/* We used to also ack ENISR_OVER here, but that would sometimes mask
@@ -781,6 +1236,9 @@ static void ei_rx_overrun(struct net_device *dev)
 	unsigned char was_txing, must_resend = 0;
 	/* ei_local is used on some platforms via the EI_SHIFT macro */
 	struct ei_device *ei_local __maybe_unused = netdev_priv(dev);
+	u64 t0 = ei_window_begin(dev);
+
+	ei_recover_begin(dev, EI_FAULT_RX_OVERRUN);
 
 	/*
 	 * Record whether a Tx was in progress and then issue the
@@ -832,12 +1290,17 @@ static void ei_rx_overrun(struct net_device *dev)
 	ei_receive(dev);
 	ei_outb_p(ENISR_OVER, e8390_base+EN0_ISR);
 
+	/* Account for what the overrun cost now, not at the next stats read. */
+	dev->stats.rx_missed_errors += ei_inb_p(e8390_base + EN0_COUNTER2);
+
 	/*
 	 * Leave loopback mode, and resend any packet that got stopped.
 	 */
 	ei_outb_p(E8390_TXCONFIG, e8390_base + EN0_TXCR);
 	if (must_resend)
 		ei_outb_p(E8390_NODMA + E8390_PAGE0 + E8390_START + E8390_TRANS, e8390_base + E8390_CMD);
+	ei_recover_end(dev, EI_FAULT_RX_OVERRUN);
+	ei_window_end(dev, EI_WIN_OVERRUN, t0);
 }
 
 /*
@@ -849,16 +1312,21 @@ static struct net_device_stats *__ei_get_stats(struct net_device *dev)
 	unsigned long ioaddr = dev->base_addr;
 	struct ei_device *ei_local = netdev_priv(dev);
 	unsigned long flags;
+	u64 t0;
 
 	/* If the card is stopped, just return the present stats. */
 	if (!netif_running(dev))
 		return &dev->stats;
 
 	spin_lock_irqsave(&ei_local->page_lock, flags);
+	t0 = ei_window_begin(dev);
+	ei_prof_begin(dev, EI_PROF_STATS);
 	/* Read the counter registers, assuming we are in page 0. */
 	dev->stats.rx_frame_errors  += ei_inb_p(ioaddr + EN0_COUNTER0);
 	dev->stats.rx_crc_errors    += ei_inb_p(ioaddr + EN0_COUNTER1);
 	dev->stats.rx_missed_errors += ei_inb_p(ioaddr + EN0_COUNTER2);
+	ei_prof_end(dev, EI_PROF_STATS);
+	ei_window_end(dev, EI_WIN_STATS, t0);
 	spin_unlock_irqrestore(&ei_local->page_lock, flags);
 
 	return &dev->stats;
@@ -897,6 +1365,8 @@ static void do_set_multicast_list(struct net_device *dev)
 	int i;
 	struct ei_device *ei_local = netdev_priv(dev);
 
+	ei_prof_begin(dev, EI_PROF_MCAST);
+
 	if (!(dev->flags&(IFF_PROMISC|IFF_ALLMULTI))) {
 		memset(ei_local->mcfilter, 0, 8);
 		if (!netdev_mc_empty(dev))
@@ -936,6 +1406,8 @@ static void do_set_multicast_list(struct net_device *dev)
 		ei_outb_p(E8390_RXCONFIG | 0x08, e8390_base + EN0_RXCR);
 	else
 		ei_outb_p(E8390_RXCONFIG, e8390_base + EN0_RXCR);
+
+	ei_prof_end(dev, EI_PROF_MCAST);
 }
 
 /*
@@ -948,9 +1420,12 @@ static void __ei_set_multicast_list(struct net_device *dev)
 {
 	unsigned long flags;
 	struct ei_device *ei_local = netdev_priv(dev);
+	u64 t0;
 
 	spin_lock_irqsave(&ei_local->page_lock, flags);
+	t0 = ei_window_begin(dev);
 	do_set_multicast_list(dev);
+	ei_window_end(dev, EI_WIN_MCAST, t0);
 	spin_unlock_irqrestore(&ei_local->page_lock, flags);
 }
 
@@ -971,6 +1446,25 @@ static void ethdev_setup(struct net_device *dev)
 	ether_setup(dev);
 
 	spin_lock_init(&ei_local->page_lock);
+	ei_local->dev = dev;
+	skb_queue_head_init(&ei_local->tx_stage[EI_TXQ_BULK]);
+	skb_queue_head_init(&ei_local->tx_stage[EI_TXQ_PRIO]);
+	INIT_WORK(&ei_local->tx_work, ei_tx_work);
+}
+
+/*
+ * Two Tx queues as two traffic classes: interactive and control
+ * priorities (VoIP, routing, ...) go to EI_TXQ_PRIO, everything else to
+ * EI_TXQ_BULK. The stack's default queue selection follows this map;
+ * mqprio or tc can override it.
+ */
+static void ei_set_tx_prio_map(struct net_device *dev)
+{
+	netdev_set_num_tc(dev, EI_TX_QUEUES);
+	netdev_set_tc_queue(dev, EI_TXQ_BULK, 1, EI_TXQ_BULK);
+	netdev_set_tc_queue(dev, EI_TXQ_PRIO, 1, EI_TXQ_PRIO);
+	netdev_set_prio_tc_map(dev, TC_PRIO_INTERACTIVE, EI_TXQ_PRIO);
+	netdev_set_prio_tc_map(dev, TC_PRIO_CONTROL, EI_TXQ_PRIO);
 }
 
 /**
@@ -981,8 +1475,13 @@ static void ethdev_setup(struct net_device *dev)
  */
 static struct net_device *____alloc_ei_netdev(int size)
 {
-	return alloc_netdev(sizeof(struct ei_device) + size, "eth%d",
-				ethdev_setup);
+	struct net_device *dev;
+
+	dev = alloc_netdev_mqs(sizeof(struct ei_device) + size, "eth%d",
+			       ethdev_setup, EI_TX_QUEUES, 1);
+	if (dev)
+		ei_set_tx_prio_map(dev);
+	return dev;
 }
 
 
@@ -1004,8 +1503,8 @@ static void __NS8390_init(struct net_device *dev, int startp)
 	unsigned long e8390_base = dev->base_addr;
 	struct ei_device *ei_local = netdev_priv(dev);
 	int i;
-	int endcfg = ei_local->word16
-	    ? (0x48 | ENDCFG_WTS | (ei_local->bigendian ? ENDCFG_BOS : 0))
+	int endcfg = ei_word16(ei_local)
+	    ? (0x48 | ENDCFG_WTS | (ei_bigendian(ei_local) ? ENDCFG_BOS : 0))
 	    : 0x48;
 
 	if (sizeof(struct e8390_pkt_hdr) != 4)
@@ -1029,6 +1528,7 @@ static void __NS8390_init(struct net_device *dev, int startp)
 	/* Clear the pending interrupts and mask. */
 	ei_outb_p(0xFF, e8390_base + EN0_ISR);
 	ei_outb_p(0x00,  e8390_base + EN0_IMR);
+	ei_local->isr_lost = 0;
 
 	/* Copy the station address into the DS8390 registers. */
 
@@ -1045,6 +1545,8 @@ static void __NS8390_init(struct net_device *dev, int startp)
 
 	ei_local->tx1 = ei_local->tx2 = 0;
 	ei_local->txing = 0;
+	ei_tx_complete(ei_local, 0, 0);
+	ei_tx_complete(ei_local, 1, 0);
 
 	if (startp) {
 		ei_outb_p(0xff,  e8390_base + EN0_ISR);
@@ -0,0 +1,593 @@
+/*
+ * ax88796-bench: runs the driver core against a software model of an
+ * X-Surf 100 and reports what it costs on the bus.
+ *
+ * ax88796.c (with lib8390.c) is compiled in here unchanged, with the
+ * ax_read*()/ax_write*() accessor overrides pointing at the model, see
+ * model.c, and the kernel services it needs supplied by kshim.c. The
+ * harness plays the Zorro bus, the network stack, the Tx qdisc and the
+ * Tx watchdog, and a traffic generator on the far end of the wire.
+ *
+ * Each scenario offers a load for a stretch of model time and reports
+ * frames/s, bus cycles per frame and overruns, with the frames lost and
+ * damaged on the way for a sanity check. Time is model time: bus cycles
+ * at -c ns each plus whatever the wire takes, so results are exactly
+ * repeatable for a given seed and do not depend on the host.
+ */
+#include <getopt.h>
+
+#include "model.h"
+
+#define ax_readb(_a) model_readb(_a)
+#define ax_writeb(_v, _a) model_writeb(_v, _a)
+#define ax_readw(_a) model_readw(_a)
+#define ax_writew(_v, _a) model_writew(_v, _a)
+#define ax_readl(_a) model_readl(_a)
+#define ax_writel(_v, _a) model_writel(_v, _a)
+
+#include "../../ax88796.c"
+
+#define BENCH_ZBASE	0x00ea0000UL	/* where the Zorro II autoconfig put us */
+#define BENCH_PROTO	0x88b5		/* as the self test */
+#define BENCH_QLEN	1000		/* qdisc limit, as txqueuelen */
+#define BENCH_IMIX_MEAN	358		/* (7 * 60 + 4 * 590 + 1514) / 12 */
+#define BENCH_TRACE_LEN	(1 << 20)	/* -T records, from the open */
+
+static const unsigned char bench_mac[ETH_ALEN] = { 0x00, 0x0d, 0xb9, 0x12, 0x34, 0x56 };
+static const unsigned char peer_mac[ETH_ALEN] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+static struct {
+	const char *name;
+	unsigned int len;		/* 0: imix */
+	bool rx, tx;
+} scenarios[] = {
+	{ "rx-64",	64,	true,	false },
+	{ "rx-1514",	1514,	true,	false },
+	{ "rx-imix",	0,	true,	false },
+	{ "tx-64",	64,	false,	true },
+	{ "tx-1514",	1514,	false,	true },
+	{ "tx-imix",	0,	false,	true },
+	{ "bidir-64",	64,	true,	true },
+	{ "bidir-1514",	1514,	true,	true },
+	{ "bidir-imix",	0,	true,	true },
+};
+
+/* options */
+static unsigned int opt_ms = 1000;	/* model time per scenario */
+static unsigned int opt_cycle = 560;	/* ns per bus cycle: Zorro II */
+static unsigned int opt_rate = 100;	/* offered load, percent of line rate */
+static unsigned long opt_seed = 1;
+static const char *opt_only;
+#ifdef CONFIG_AX88796_TRACE
+static const char *opt_trace;
+#endif
+
+/* one side of the traffic: a paced, numbered frame sequence */
+struct flow {
+	bool on;
+	u32 seq;			/* next to generate */
+	u32 expect;			/* next to check */
+	u64 next_t;			/* ns when the next frame is due */
+	u64 stop_t;
+	unsigned long frames, bytes;	/* checked good, within the window */
+	unsigned long total;		/* checked good, drain included */
+	unsigned long lost, bad, ooo;
+};
+
+static struct {
+	struct net_device *dev;
+	unsigned int len;
+	unsigned long rng;
+	struct flow rx, tx;		/* as seen from the board */
+	unsigned long tx_qdrop;		/* over BENCH_QLEN */
+	unsigned long tx_busy;		/* NETDEV_TX_BUSY from the driver */
+	unsigned long tx_timeouts;
+	unsigned long stale;
+	u32 run;			/* top byte of every seq */
+} b;
+
+static unsigned int backlog;		/* frames due but not yet handed over */
+static struct sk_buff *requeued;
+
+static unsigned int bench_rand(void)
+{
+	b.rng = b.rng * 1103515245 + 12345;
+	return (b.rng >> 16) & 0x7fff;
+}
+
+/* 7:4:1 small, medium, large */
+static unsigned int frame_len(void)
+{
+	static const unsigned short imix[12] = {
+		60, 60, 60, 60, 60, 60, 60, 590, 590, 590, 590, 1514
+	};
+
+	return b.len ? b.len : imix[bench_rand() % 12];
+}
+
+static u64 pace(unsigned int len)
+{
+	return model_wire_ns(len) * 100 / opt_rate;
+}
+
+static void fill(unsigned char *d, unsigned int len, const unsigned char *dst,
+		 const unsigned char *src, u32 seq)
+{
+	unsigned int i;
+
+	memcpy(d, dst, ETH_ALEN);
+	memcpy(d + ETH_ALEN, src, ETH_ALEN);
+	d[12] = BENCH_PROTO >> 8;
+	d[13] = BENCH_PROTO & 0xff;
+	memcpy(d + ETH_HLEN, &seq, sizeof(seq));
+	for (i = ETH_HLEN + sizeof(seq); i < len; i++)
+		d[i] = seq + i;
+}
+
+/* payload from the ethertype on; false if damaged */
+static bool check(struct flow *f, const unsigned char *p, unsigned int len)
+{
+	u32 seq;
+	unsigned int i;
+
+	if (len < 2 + sizeof(seq) || p[0] != BENCH_PROTO >> 8 ||
+	    p[1] != (BENCH_PROTO & 0xff)) {
+		f->bad++;
+		return false;
+	}
+	memcpy(&seq, p + 2, sizeof(seq));
+	if (seq >> 24 != b.run) {
+		b.stale++;		/* left in the ring by an earlier scenario */
+		return false;
+	}
+	for (i = 2 + sizeof(seq); i < len; i++)
+		if (p[i] != (unsigned char)(seq + i + ETH_HLEN - 2)) {
+			f->bad++;
+			return false;
+		}
+
+	if (seq < f->expect) {
+		f->ooo++;
+		return false;
+	}
+	f->lost += seq - f->expect;
+	f->expect = seq + 1;
+	f->total++;
+	if (model_now() <= f->stop_t) {
+		f->frames++;
+		f->bytes += len + ETH_HLEN - 2;
+	}
+	return true;
+}
+
+/* the far end: offers Rx frames, sinks what the board sends */
+static bool wire_src(void *ctx, struct model_frame *f)
+{
+	if (!b.rx.on || b.rx.next_t >= b.rx.stop_t)
+		return false;
+
+	f->t = b.rx.next_t;
+	f->len = frame_len();
+	fill(f->data, f->len, bench_mac, peer_mac, b.rx.seq++);
+	b.rx.next_t += pace(f->len);
+	return true;
+}
+
+static void wire_sink(void *ctx, const unsigned char *d, unsigned int len,
+		      uint64_t t)
+{
+	if (len < ETH_HLEN || memcmp(d, peer_mac, ETH_ALEN))
+		b.tx.bad++;
+	else
+		check(&b.tx, d + 12, len - 12);
+}
+
+/* the stack */
+void kshim_rx(struct sk_buff *skb)
+{
+	if (skb->protocol == htons(BENCH_PROTO))
+		check(&b.rx, skb->data - 2, skb->len + 2);
+	else
+		b.rx.bad++;
+	kfree_skb(skb);
+}
+
+u64 kshim_now(void)
+{
+	return model_now();
+}
+
+void kshim_idle(u64 ns)
+{
+	model_advance(ns);
+}
+
+bool kshim_irq_asserted(int irq)
+{
+	return irq == IRQ_AMIGA_PORTS && model_irq();
+}
+
+static void bench_irq_hook(void)
+{
+	kshim_irq(IRQ_AMIGA_PORTS);
+}
+
+/* the Zorro bus, with one X-Surf 100 on it */
+static struct zorro_dev bench_zdev = {
+	.resource = { BENCH_ZBASE, BENCH_ZBASE + 0xffff },
+	.dev = { .init_name = "xsurf100.0" },
+};
+static struct zorro_driver *bench_zdrv;
+
+void *request_mem_region(unsigned long start, unsigned long n, const char *name)
+{
+	return (void *)name;
+}
+
+void release_mem_region(unsigned long start, unsigned long n)
+{
+}
+
+void *z_ioremap(unsigned long phys, unsigned long size)
+{
+	if (phys < BENCH_ZBASE || phys + size > BENCH_ZBASE + MODEL_WIN_SIZE)
+		return NULL;
+	return model_map(phys - BENCH_ZBASE);
+}
+
+void z_iounmap(void *addr)
+{
+}
+
+int zorro_register_driver(struct zorro_driver *drv)
+{
+	bench_zdev.id = drv->id_table[0].id;
+	bench_zdrv = drv;
+	return drv->probe(&bench_zdev, &drv->id_table[0]);
+}
+
+void zorro_unregister_driver(struct zorro_driver *drv)
+{
+	drv->remove(&bench_zdev);
+	bench_zdrv = NULL;
+}
+
+/* what dev_queue_xmit() and the qdisc would do; true if it got anywhere */
+static bool bench_xmit(void)
+{
+	struct net_device *dev = b.dev;
+	struct sk_buff *skb;
+	bool progress = false;
+	unsigned int len;
+
+	while (b.tx.on && b.tx.next_t <= model_now() &&
+	       b.tx.next_t < b.tx.stop_t) {
+		if (backlog < BENCH_QLEN)
+			backlog++;
+		else
+			b.tx_qdrop++;
+		b.tx.next_t += pace(b.len ? b.len : BENCH_IMIX_MEAN);
+	}
+
+	while (backlog && !__netif_subqueue_stopped(dev, EI_TXQ_BULK)) {
+		skb = requeued;
+		requeued = NULL;
+		if (!skb) {
+			len = frame_len();
+			skb = netdev_alloc_skb(dev, len);
+			if (!skb)
+				panic("out of memory\n");
+			fill(skb_put(skb, len), len, peer_mac, bench_mac,
+			     b.tx.seq++);
+			skb->queue_mapping = EI_TXQ_BULK;
+		}
+		skb->xmit_more = backlog > 1;
+
+		if (dev->netdev_ops->ndo_start_xmit(skb, dev) != NETDEV_TX_OK) {
+			b.tx_busy++;
+			requeued = skb;
+			break;
+		}
+		dev->trans_start = jiffies;
+		backlog--;
+		progress = true;
+	}
+	return progress;
+}
+
+/* dev_watchdog() */
+static u64 wd_next;
+
+static void bench_watchdog(void)
+{
+	struct net_device *dev = b.dev;
+	u64 period = (u64)dev->watchdog_timeo * (NSEC_PER_SEC / HZ);
+
+	if (model_now() < wd_next)
+		return;
+	wd_next = model_now() + period;
+
+	if (dev->tx_stopped && netif_carrier_ok(dev) &&
+	    time_after(jiffies, dev->trans_start + dev->watchdog_timeo)) {
+		b.tx_timeouts++;
+		dev->netdev_ops->ndo_tx_timeout(dev);
+	}
+}
+
+static void run(u64 until)
+{
+	for (;;) {
+		u64 next;
+		bool busy;
+
+		busy = kshim_run_work() != 0;
+		busy |= bench_xmit();
+		bench_watchdog();
+		/* a driver kept busy must not carry us past @until */
+		if (busy && model_now() < until)
+			continue;
+
+		next = min(model_next_event(), kshim_next_work());
+		next = min(next, wd_next);
+		if (b.tx.on && b.tx.next_t < b.tx.stop_t)
+			next = min(next, b.tx.next_t);
+		if (next >= until)
+			break;
+		/* zero still applies whatever is due right now */
+		kshim_idle(next > model_now() ? next - model_now() : 0);
+	}
+	if (until > model_now())
+		kshim_idle(until - model_now());
+}
+
+static void bench_stats(struct net_device *dev, u64 *data)
+{
+	struct ethtool_stats st = { 0 };
+
+	dev->ethtool_ops->get_ethtool_stats(dev, &st, data);
+}
+
+static int stat_index(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ax_stats); i++)
+		if (!strcmp(ax_stats[i].name, name))
+			return i;
+	return -1;
+}
+
+static void report(const char *name, struct net_device_stats *s0,
+		   struct model_stats *m0, u64 *st0)
+{
+	struct net_device *dev = b.dev;
+	struct net_device_stats *s = &dev->stats;
+	u64 st[ARRAY_SIZE(ax_stats)];
+	double secs = opt_ms / 1000.0;
+	unsigned long frames = b.rx.total + b.tx.total;
+	u64 cycles = model_stats.cycles - m0->cycles;
+	int y = stat_index("dma_tx_yield");
+
+	bench_stats(dev, st);
+
+	printf("%-11s %9.0f %9.0f %8.1f %9.0f %7lu %7lu %7lu %6lu %6lu %7lu\n",
+	       name, b.rx.frames / secs, b.tx.frames / secs,
+	       (b.rx.bytes + b.tx.bytes) * 8 / secs / 1e6,
+	       frames ? (double)cycles / frames : 0.0,
+	       s->rx_over_errors - s0->rx_over_errors,
+	       (unsigned long)(model_stats.rx_missed - m0->rx_missed),
+	       b.rx.lost + b.tx.lost,
+	       b.rx.bad + b.tx.bad + b.rx.ooo + b.tx.ooo,
+	       b.tx_timeouts,
+	       y < 0 ? 0UL : (unsigned long)(st[y] - st0[y]));
+}
+
+static void scenario(int i)
+{
+	struct net_device *dev = b.dev;
+	struct net_device_stats s0 = dev->stats;
+	struct model_stats m0 = model_stats;
+	u64 st0[ARRAY_SIZE(ax_stats)];
+	u64 t;
+
+	bench_stats(dev, st0);
+	memset(&b.rx, 0, sizeof(b.rx));
+	memset(&b.tx, 0, sizeof(b.tx));
+	b.tx_qdrop = b.tx_busy = b.tx_timeouts = b.stale = 0;
+	b.run++;
+	b.rx.seq = b.rx.expect = b.tx.seq = b.tx.expect = b.run << 24;
+	b.len = scenarios[i].len;
+	b.rng = opt_seed;
+
+	t = model_now();
+	b.rx.on = scenarios[i].rx;
+	b.tx.on = scenarios[i].tx;
+	b.rx.next_t = b.tx.next_t = t;
+	b.rx.stop_t = b.tx.stop_t = t + (u64)opt_ms * NSEC_PER_MSEC;
+	model_set_wire(wire_src, wire_sink, NULL);
+
+	/* offered load; what the qdisc still holds at the end is dropped */
+	run(b.rx.stop_t);
+	if (requeued) {
+		kfree_skb(requeued);
+		requeued = NULL;
+		b.tx.seq--;
+	}
+	backlog = 0;
+
+	/* up to 100ms for what is in flight, then whatever never turned up */
+	run(b.rx.stop_t + 100 * NSEC_PER_MSEC);
+	b.rx.lost += b.rx.seq - b.rx.expect;
+	b.tx.lost += b.tx.seq - b.tx.expect;
+
+	report(scenarios[i].name, &s0, &m0, st0);
+	b.rx.on = b.tx.on = false;
+	model_set_wire(NULL, wire_sink, NULL);
+}
+
+static void self_test(void)
+{
+	struct net_device *dev = b.dev;
+	struct ethtool_test test = { .flags = ETH_TEST_FL_OFFLINE };
+	int n = dev->ethtool_ops->get_sset_count(dev, ETH_SS_TEST);
+	u64 cycles = model_stats.cycles;
+	u8 names[16][ETH_GSTRING_LEN];
+	u64 data[16];
+	int i;
+
+	if (n <= 0 || n > 16)
+		return;
+	dev->ethtool_ops->get_strings(dev, ETH_SS_TEST, &names[0][0]);
+	dev->ethtool_ops->self_test(dev, &test, data);
+	run(model_now() + 10 * NSEC_PER_MSEC);
+
+	printf("\nself test: %s, %llu bus cycles\n",
+	       test.flags & ETH_TEST_FL_FAILED ? "FAILED" : "passed",
+	       (unsigned long long)(model_stats.cycles - cycles));
+	for (i = 0; i < n; i++)
+		printf("  %-24.*s %llu\n", ETH_GSTRING_LEN, names[i],
+		       (unsigned long long)data[i]);
+}
+
+#ifdef CONFIG_AX88796_TRACE
+/* the debugfs trace file, for ax88796-replay */
+static void trace_dump(void)
+{
+	struct seq_file m = { .private = b.dev };
+
+	m.out = fopen(opt_trace, "w");
+	if (!m.out) {
+		perror(opt_trace);
+		return;
+	}
+	ax_trace_show(&m, NULL);
+	fclose(m.out);
+}
+#endif
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: ax88796-bench [options] [scenario]\n"
+		"  -t ms        model time per scenario (%u)\n"
+		"  -c ns        bus cycle (%u, Zorro II; 140 for Zorro III)\n"
+		"  -r percent   offered load, of 100 Mbit/s line rate (%u)\n"
+		"  -s seed      imix sequence (%lu)\n"
+		"  -p name=val  driver parameter: dma_chunk, rx_watermark, tx_reserve\n"
+#ifdef CONFIG_AX88796_FAULT_INJECT
+		"  -F name=pct  inject faults, as debugfs fail_<name>/probability\n"
+#endif
+#ifdef CONFIG_AX88796_TRACE
+		"  -T file      register trace from the open, for ax88796-replay\n"
+#endif
+		"  -v           driver messages, twice for debug\n",
+		opt_ms, opt_cycle, opt_rate, opt_seed);
+	exit(2);
+}
+
+static void set_param(char *arg, bool fault)
+{
+	char *eq = strchr(arg, '=');
+	unsigned int v;
+
+	if (!eq || kstrtouint(eq + 1, 0, &v))
+		usage();
+	*eq = 0;
+
+#ifdef CONFIG_AX88796_FAULT_INJECT
+	if (fault) {
+		int i;
+
+		for (i = 0; i < EI_FAULT_NR; i++)
+			if (!strcmp(arg, ax_fault_names[i])) {
+				ax_fail_attr[i].probability = v;
+				return;
+			}
+		usage();
+	}
+#endif
+	if (!strcmp(arg, "dma_chunk"))
+		dma_chunk = v;
+	else if (!strcmp(arg, "rx_watermark"))
+		rx_watermark = v;
+	else if (!strcmp(arg, "tx_reserve"))
+		tx_reserve = v;
+	else
+		usage();
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, ret;
+
+	while ((c = getopt(argc, argv, "t:c:r:s:p:F:T:vh")) != -1) {
+		switch (c) {
+		case 't': opt_ms = strtoul(optarg, NULL, 0); break;
+		case 'c': opt_cycle = strtoul(optarg, NULL, 0); break;
+		case 'r': opt_rate = strtoul(optarg, NULL, 0); break;
+		case 's': opt_seed = strtoul(optarg, NULL, 0); break;
+		case 'p': set_param(optarg, false); break;
+#ifdef CONFIG_AX88796_FAULT_INJECT
+		case 'F': set_param(optarg, true); break;
+#endif
+#ifdef CONFIG_AX88796_TRACE
+		case 'T': opt_trace = optarg; break;
+#endif
+		case 'v': kshim_loglevel++; break;
+		default: usage();
+		}
+	}
+	if (optind < argc)
+		opt_only = argv[optind];
+	if (!opt_ms || !opt_cycle || !opt_rate || opt_rate > 100)
+		usage();
+	srandom(opt_seed);
+
+	model_init(bench_mac, opt_cycle);
+	model_irq_hook = bench_irq_hook;
+#ifdef CONFIG_AX88796_TRACE
+	if (opt_trace)
+		trace_entries = BENCH_TRACE_LEN;
+#endif
+
+	ret = ax_init_module();
+	if (ret) {
+		fprintf(stderr, "probe failed: %d\n", ret);
+		return 1;
+	}
+	b.dev = zorro_get_drvdata(&bench_zdev);
+#ifdef CONFIG_AX88796_TRACE
+	/* keep the oldest, so that a replay can start at the open */
+	if (opt_trace)
+		trace = 2;
+#endif
+
+	ret = kshim_dev_open(b.dev);
+	if (ret) {
+		fprintf(stderr, "open failed: %d\n", ret);
+		return 1;
+	}
+	run(model_now() + 100 * NSEC_PER_MSEC);
+
+	printf("%u ms per scenario, %u ns bus cycle, %u%% load, dma_chunk %u\n\n",
+	       opt_ms, opt_cycle, opt_rate, dma_chunk);
+	printf("%-11s %9s %9s %8s %9s %7s %7s %7s %6s %6s %7s\n",
+	       "scenario", "rx fps", "tx fps", "Mbit/s", "cyc/frame",
+	       "overrun", "missed", "lost", "bad", "txto", "yield");
+	for (i = 0; i < ARRAY_SIZE(scenarios); i++)
+		if (!opt_only || !strcmp(opt_only, scenarios[i].name))
+			scenario(i);
+	if (!opt_only || !strcmp(opt_only, "selftest"))
+		self_test();
+
+	kshim_dev_close(b.dev);
+#ifdef CONFIG_AX88796_TRACE
+	if (opt_trace)
+		trace_dump();
+#endif
+	ax_exit_module();
+	if (kshim_stats.skbs)
+		fprintf(stderr, "%llu skbs leaked\n",
+			(unsigned long long)kshim_stats.skbs);
+	return 0;
+}
@@ -0,0 +1,789 @@
+/*
+ * Userspace stand-ins for the kernel services the driver uses, see
+ * kshim.h. Single threaded: "process context" is whatever the harness is
+ * running, "interrupt context" is kshim_irq() calling the handler from
+ * inside a bus access.
+ */
+#include <stdarg.h>
+
+#include "kshim.h"
+
+int kshim_loglevel = KS_WARN;
+struct kshim_stats kshim_stats;
+struct workqueue_struct *system_wq, *system_highpri_wq;
+
+/* vfprintf() plus the kernel's %pM; the driver uses no other %p extension */
+static void kshim_vprintk(const char *fmt, va_list ap)
+{
+	char spec[16];
+	const char *p;
+	size_t n;
+
+	while (*fmt) {
+		p = strchr(fmt, '%');
+		if (!p) {
+			fputs(fmt, stderr);
+			return;
+		}
+		fwrite(fmt, 1, p - fmt, stderr);
+
+		n = strspn(p + 1, "#0- +'.0123456789hlzjt") + 2;
+		if (n >= sizeof(spec) || !p[n - 1])
+			panic("bad printk format %s\n", p);
+		memcpy(spec, p, n);
+		spec[n] = 0;
+		fmt = p + n;
+
+		switch (spec[n - 1]) {
+		case '%':
+			fputc('%', stderr);
+			break;
+		case 'p':
+			if (*fmt == 'M') {
+				const u8 *a = va_arg(ap, const u8 *);
+
+				fprintf(stderr, "%02x:%02x:%02x:%02x:%02x:%02x",
+					a[0], a[1], a[2], a[3], a[4], a[5]);
+				fmt++;
+			} else {
+				fprintf(stderr, spec, va_arg(ap, void *));
+			}
+			break;
+		case 's':
+			fprintf(stderr, spec, va_arg(ap, const char *));
+			break;
+		case 'c':
+			fprintf(stderr, spec, va_arg(ap, int));
+			break;
+		default:
+			if (strstr(spec, "ll") || strchr(spec, 'j'))
+				fprintf(stderr, spec, va_arg(ap, long long));
+			else if (strchr(spec, 'l') || strchr(spec, 'z') ||
+				 strchr(spec, 't'))
+				fprintf(stderr, spec, va_arg(ap, long));
+			else
+				fprintf(stderr, spec, va_arg(ap, int));
+			break;
+		}
+	}
+}
+
+void kshim_printk(int level, const char *who, const char *fmt, ...)
+{
+	static const char *const tag[] = { "err", "warn", "info", "dbg" };
+	va_list ap;
+
+	if (level > kshim_loglevel)
+		return;
+	if (who)
+		fprintf(stderr, "[%10.6f] %s%s%s: ", kshim_now() / 1e9,
+			who, *who ? " " : "", tag[level]);
+	va_start(ap, fmt);
+	kshim_vprintk(fmt, ap);
+	va_end(ap);
+}
+
+void kshim_warn(const char *file, int line)
+{
+	fprintf(stderr, "WARNING at %s:%d\n", file, line);
+}
+
+void panic(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "panic: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len = strlen(src);
+
+	if (size) {
+		size_t n = len >= size ? size - 1 : len;
+
+		memcpy(dst, src, n);
+		dst[n] = 0;
+	}
+	return len;
+}
+
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (!size)
+		return 0;
+	va_start(ap, fmt);
+	n = vsnprintf(buf, size, fmt, ap);
+	va_end(ap);
+	return n >= (int)size ? (int)size - 1 : n;
+}
+
+void sort(void *base, size_t num, size_t size,
+	  int (*cmp)(const void *, const void *),
+	  void (*swap)(void *, void *, int))
+{
+	qsort(base, num, size, cmp);
+}
+
+int kstrtouint(const char *s, unsigned int base, unsigned int *res)
+{
+	char *end;
+	unsigned long v = strtoul(s, &end, base);
+
+	if (end == s || (*end && *end != '\n'))
+		return -EINVAL;
+	*res = v;
+	return 0;
+}
+
+/*
+ * Interrupts. One flag for the local CPU, a disable depth per line. The
+ * line is level triggered: whenever delivery becomes possible again the
+ * harness is asked whether it is still asserted.
+ */
+#define KSHIM_NR_IRQS		8
+#define KSHIM_IRQ_STORM		100000	/* unhandled in a row, as note_interrupt() */
+
+static struct {
+	irqreturn_t (*handler)(int, void *);
+	void *dev_id;
+	int depth;
+	unsigned int unhandled;
+} irqs[KSHIM_NR_IRQS];
+
+static bool irqs_off, in_irq;
+
+static void kshim_irq_check(void)
+{
+	int i;
+
+	for (i = 0; i < KSHIM_NR_IRQS; i++)
+		if (irqs[i].handler && kshim_irq_asserted(i))
+			kshim_irq(i);
+}
+
+void kshim_irq(int irq)
+{
+	irqreturn_t ret;
+
+	if (irq < 0 || irq >= KSHIM_NR_IRQS || !irqs[irq].handler ||
+	    irqs[irq].depth || irqs_off || in_irq)
+		return;
+
+	in_irq = irqs_off = true;
+	kshim_stats.irqs++;
+	ret = irqs[irq].handler(irq, irqs[irq].dev_id);
+	in_irq = irqs_off = false;
+
+	if (ret == IRQ_HANDLED) {
+		irqs[irq].unhandled = 0;
+		return;
+	}
+	kshim_stats.irqs_unhandled++;
+	if (++irqs[irq].unhandled == KSHIM_IRQ_STORM) {
+		fprintf(stderr, "irq %d: nobody cared, disabling\n", irq);
+		irqs[irq].depth++;
+	}
+}
+
+unsigned long kshim_irq_save(void)
+{
+	unsigned long flags = irqs_off;
+
+	irqs_off = true;
+	return flags;
+}
+
+void kshim_irq_restore(unsigned long flags)
+{
+	irqs_off = flags;
+	if (!irqs_off && !in_irq)
+		kshim_irq_check();
+}
+
+int request_irq(int irq, irqreturn_t (*handler)(int, void *),
+		unsigned long flags, const char *name, void *dev_id)
+{
+	if (irq < 0 || irq >= KSHIM_NR_IRQS || irqs[irq].handler)
+		return -EBUSY;
+	irqs[irq].handler = handler;
+	irqs[irq].dev_id = dev_id;
+	irqs[irq].depth = 0;
+	irqs[irq].unhandled = 0;
+	if (!irqs_off && !in_irq)
+		kshim_irq_check();
+	return 0;
+}
+
+void free_irq(int irq, void *dev_id)
+{
+	if (irqs[irq].dev_id != dev_id)
+		panic("free_irq(%d) with the wrong dev_id\n", irq);
+	irqs[irq].handler = NULL;
+}
+
+void disable_irq_nosync(int irq)
+{
+	irqs[irq].depth++;
+}
+
+void enable_irq(int irq)
+{
+	if (!irqs[irq].depth) {
+		fprintf(stderr, "unbalanced enable for irq %d\n", irq);
+		return;
+	}
+	if (!--irqs[irq].depth && !irqs_off && !in_irq)
+		kshim_irq_check();
+}
+
+/* work queues: one worker, run by the harness between its own steps */
+static LIST_HEAD(work_list);
+
+void kshim_init_work(struct work_struct *w, void (*func)(struct work_struct *))
+{
+	memset(w, 0, sizeof(*w));
+	w->func = func;
+}
+
+static bool queue_at(struct work_struct *w, u64 due)
+{
+	if (w->pending)
+		return false;
+	w->pending = true;
+	w->due = due;
+	list_add_tail(&w->entry, &work_list);
+	return true;
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *w)
+{
+	return queue_at(w, kshim_now());
+}
+
+bool schedule_delayed_work(struct delayed_work *dw, unsigned long delay)
+{
+	return queue_at(&dw->work, kshim_now() + (u64)delay * (NSEC_PER_SEC / HZ));
+}
+
+static void run_one(struct work_struct *w)
+{
+	list_del(&w->entry);
+	w->pending = false;
+	w->func(w);
+}
+
+int kshim_run_work(void)
+{
+	struct work_struct *w;
+	int n = 0;
+
+again:
+	list_for_each_entry(w, &work_list, entry) {
+		if (w->due <= kshim_now()) {
+			run_one(w);
+			n++;
+			goto again;
+		}
+	}
+	return n;
+}
+
+u64 kshim_next_work(void)
+{
+	struct work_struct *w;
+	u64 t = UINT64_MAX;
+
+	list_for_each_entry(w, &work_list, entry)
+		if (w->due < t)
+			t = w->due;
+	return t;
+}
+
+bool flush_work(struct work_struct *w)
+{
+	if (!w->pending)
+		return false;
+	run_one(w);
+	return true;
+}
+
+bool cancel_work_sync(struct work_struct *w)
+{
+	if (!w->pending)
+		return false;
+	list_del(&w->entry);
+	w->pending = false;
+	return true;
+}
+
+void kshim_sleep(u64 ns)
+{
+	u64 end = kshim_now() + ns;
+
+	if (irqs_off || in_irq)
+		panic("sleeping with interrupts off\n");
+	while (kshim_now() < end) {
+		u64 next = kshim_next_work();
+
+		kshim_run_work();
+		if (next > end)
+			next = end;
+		if (next > kshim_now())
+			kshim_idle(next - kshim_now());
+	}
+}
+
+/* debugfs and fault attributes: accepted, nothing exported */
+static char kshim_dentry;
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return (struct dentry *)&kshim_dentry;
+}
+
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+				   struct dentry *parent, void *data,
+				   const struct file_operations *fops)
+{
+	return (struct dentry *)&kshim_dentry;
+}
+
+void debugfs_remove_recursive(struct dentry *d)
+{
+}
+
+int seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (!m->out)
+		return 0;
+	va_start(ap, fmt);
+	vfprintf(m->out, fmt, ap);
+	va_end(ap);
+	return 0;
+}
+
+int seq_puts(struct seq_file *m, const char *s)
+{
+	if (m->out)
+		fputs(s, m->out);
+	return 0;
+}
+
+int single_open(struct file *f, int (*show)(struct seq_file *, void *), void *d)
+{
+	return 0;
+}
+
+int single_release(struct inode *i, struct file *f)
+{
+	return 0;
+}
+
+ssize_t seq_read(struct file *f, char *buf, size_t n, loff_t *pos)
+{
+	return 0;
+}
+
+loff_t seq_lseek(struct file *f, loff_t off, int whence)
+{
+	return 0;
+}
+
+bool should_fail(struct fault_attr *attr, ssize_t size)
+{
+	if (!attr->probability || !attr->times)
+		return false;
+	if (attr->interval > 1 && ++attr->count % attr->interval)
+		return false;
+	if ((unsigned long)(random() % 100) >= attr->probability)
+		return false;
+	if (attr->times > 0)
+		attr->times--;
+	return true;
+}
+
+struct dentry *fault_create_debugfs_attr(const char *name,
+					 struct dentry *parent,
+					 struct fault_attr *attr)
+{
+	return (struct dentry *)&kshim_dentry;
+}
+
+/* sk_buffs: linear, headroom as the stack leaves it */
+struct sk_buff *netdev_alloc_skb(struct net_device *dev, unsigned int len)
+{
+	struct sk_buff *skb = calloc(1, sizeof(*skb));
+
+	if (!skb)
+		return NULL;
+	skb->size = NET_SKB_PAD + len;
+	skb->head = malloc(skb->size);
+	if (!skb->head) {
+		free(skb);
+		return NULL;
+	}
+	skb->data = skb->head + NET_SKB_PAD;
+	kshim_stats.skbs++;
+	return skb;
+}
+
+void kfree_skb(struct sk_buff *skb)
+{
+	if (!skb)
+		return;
+	if (skb->next || skb->prev)
+		panic("freeing a queued skb\n");
+	kshim_stats.skbs--;
+	free(skb->head);
+	free(skb);
+}
+
+void skb_tx_timestamp(struct sk_buff *skb)
+{
+}
+
+void skb_clone_tx_timestamp(struct sk_buff *skb)
+{
+}
+
+void skb_tstamp_tx(struct sk_buff *skb, struct skb_shared_hwtstamps *hw)
+{
+	kshim_stats.tx_stamped++;
+}
+
+/* net_device */
+struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
+				    void (*setup)(struct net_device *),
+				    unsigned int txqs, unsigned int rxqs)
+{
+	struct net_device *dev;
+
+	dev = calloc(1, (char *)netdev_priv((struct net_device *)0) -
+			(char *)0 + sizeof_priv);
+	if (!dev)
+		return NULL;
+	strlcpy(dev->name, name, sizeof(dev->name));
+	dev->num_tx_queues = dev->real_num_tx_queues = txqs;
+	if (setup)
+		setup(dev);
+	return dev;
+}
+
+void free_netdev(struct net_device *dev)
+{
+	free(dev);
+}
+
+void ether_setup(struct net_device *dev)
+{
+	dev->flags = IFF_BROADCAST | IFF_MULTICAST;
+}
+
+int register_netdev(struct net_device *dev)
+{
+	if (strchr(dev->name, '%'))
+		snprintf(dev->name, sizeof(dev->name), "eth0");
+	dev->dev.init_name = dev->name;
+	dev->state |= KSHIM_REGISTERED;
+	return 0;
+}
+
+void unregister_netdev(struct net_device *dev)
+{
+	kshim_dev_close(dev);
+	dev->state &= ~KSHIM_REGISTERED;
+}
+
+int kshim_dev_open(struct net_device *dev)
+{
+	int ret;
+
+	if (netif_running(dev))
+		return 0;
+	dev->state |= KSHIM_RUNNING;
+	ret = dev->netdev_ops->ndo_open(dev);
+	if (ret)
+		dev->state &= ~KSHIM_RUNNING;
+	return ret;
+}
+
+void kshim_dev_close(struct net_device *dev)
+{
+	if (!netif_running(dev))
+		return;
+	dev->state &= ~KSHIM_RUNNING;
+	dev->netdev_ops->ndo_stop(dev);
+}
+
+int netif_rx(struct sk_buff *skb)
+{
+	kshim_rx(skb);
+	return 0;
+}
+
+unsigned short eth_type_trans(struct sk_buff *skb, struct net_device *dev)
+{
+	unsigned short proto;
+
+	memcpy(&proto, skb->data + 12, 2);
+	skb->data += ETH_HLEN;
+	skb->len -= ETH_HLEN;
+	return proto;
+}
+
+int eth_validate_addr(struct net_device *dev)
+{
+	return is_valid_ether_addr(dev->dev_addr) ? 0 : -EINVAL;
+}
+
+int eth_mac_addr(struct net_device *dev, void *p)
+{
+	return -EOPNOTSUPP;
+}
+
+int eth_change_mtu(struct net_device *dev, int mtu)
+{
+	return mtu == 1500 ? 0 : -EINVAL;
+}
+
+u32 ether_crc(int len, const unsigned char *data)
+{
+	u32 crc = ~0U;
+	int i;
+
+	while (len--) {
+		crc ^= (u32)*data++ << 24;
+		for (i = 0; i < 8; i++)
+			crc = (crc << 1) ^ ((crc & 0x80000000U) ? 0x04c11db7 : 0);
+	}
+	return crc;
+}
+
+u32 ethtool_op_get_link(struct net_device *dev)
+{
+	return netif_carrier_ok(dev);
+}
+
+int ethtool_op_get_ts_info(struct net_device *dev, struct ethtool_ts_info *i)
+{
+	return 0;
+}
+
+/* one PHY behind the bitbanged bus, linked at 100/full */
+static const struct phy_driver kshim_phy_drv = { "kshim PHY" };
+struct phy_device kshim_phy = {
+	.link = 1, .speed = SPEED_100, .duplex = DUPLEX_FULL,
+	.drv = &kshim_phy_drv,
+};
+static struct mii_bus kshim_mii;
+
+/*
+ * kshim_phy_mdio: talk to a real PHY through the driver's bitbang ops,
+ * framed as drivers/net/phy/mdio-bitbang.c does, and read its status as
+ * genphy_read_status() would.
+ */
+bool kshim_phy_mdio;
+static struct mdiobb_ctrl *kshim_mdiobb;
+
+#define MII_BMCR		0x00
+#define MII_BMSR		0x01
+#define MII_PHYSID1		0x02
+#define MII_ADVERTISE		0x04
+#define MII_LPA			0x05
+#define BMCR_FULLDPLX		0x0100
+#define BMCR_ANENABLE		0x1000
+#define BMCR_SPEED100		0x2000
+#define BMSR_LSTATUS		0x0004
+#define LPA_10FULL		0x0040
+#define LPA_100HALF		0x0080
+#define LPA_100FULL		0x0100
+
+static void mdiobb_send_bit(struct mdiobb_ctrl *ctrl, int val)
+{
+	ctrl->ops->set_mdio_data(ctrl, val);
+	ctrl->ops->set_mdc(ctrl, 1);
+	ctrl->ops->set_mdc(ctrl, 0);
+}
+
+static int mdiobb_get_bit(struct mdiobb_ctrl *ctrl)
+{
+	ctrl->ops->set_mdc(ctrl, 1);
+	ctrl->ops->set_mdc(ctrl, 0);
+	return ctrl->ops->get_mdio_data(ctrl);
+}
+
+static void mdiobb_send_num(struct mdiobb_ctrl *ctrl, u16 val, int bits)
+{
+	int i;
+
+	for (i = bits - 1; i >= 0; i--)
+		mdiobb_send_bit(ctrl, (val >> i) & 1);
+}
+
+static int kshim_mdio_read(int addr, int reg)
+{
+	struct mdiobb_ctrl *ctrl = kshim_mdiobb;
+	int ret = 0, i;
+
+	/* preamble, start (01), read (10), PHY and register address */
+	ctrl->ops->set_mdio_dir(ctrl, 1);
+	for (i = 0; i < 32; i++)
+		mdiobb_send_bit(ctrl, 1);
+	mdiobb_send_num(ctrl, 0x6, 4);
+	mdiobb_send_num(ctrl, addr, 5);
+	mdiobb_send_num(ctrl, reg, 5);
+
+	/* the PHY drives the second turnaround bit low, or nobody is there */
+	ctrl->ops->set_mdio_dir(ctrl, 0);
+	if (mdiobb_get_bit(ctrl)) {
+		for (i = 0; i < 32; i++)
+			mdiobb_get_bit(ctrl);
+		return 0xffff;
+	}
+	for (i = 0; i < 16; i++)
+		ret = ret << 1 | mdiobb_get_bit(ctrl);
+	mdiobb_get_bit(ctrl);
+	return ret;
+}
+
+static void kshim_phy_read_status(struct phy_device *phy)
+{
+	int bmcr, lpa;
+
+	if (!kshim_phy_mdio)
+		return;
+
+	/* link down is latched until read */
+	kshim_mdio_read(phy->addr, MII_BMSR);
+	phy->link = !!(kshim_mdio_read(phy->addr, MII_BMSR) & BMSR_LSTATUS);
+
+	bmcr = kshim_mdio_read(phy->addr, MII_BMCR);
+	if (bmcr & BMCR_ANENABLE) {
+		lpa = kshim_mdio_read(phy->addr, MII_LPA) &
+		      kshim_mdio_read(phy->addr, MII_ADVERTISE);
+		phy->speed = lpa & (LPA_100FULL | LPA_100HALF) ?
+			     SPEED_100 : SPEED_10;
+		phy->duplex = lpa & (phy->speed == SPEED_100 ?
+				     LPA_100FULL : LPA_10FULL) ?
+			      DUPLEX_FULL : DUPLEX_HALF;
+	} else {
+		phy->speed = bmcr & BMCR_SPEED100 ? SPEED_100 : SPEED_10;
+		phy->duplex = bmcr & BMCR_FULLDPLX ? DUPLEX_FULL : DUPLEX_HALF;
+	}
+}
+
+struct mii_bus *alloc_mdio_bitbang(struct mdiobb_ctrl *ctrl)
+{
+	memset(&kshim_mii, 0, sizeof(kshim_mii));
+	kshim_mdiobb = ctrl;
+	return &kshim_mii;
+}
+
+void free_mdio_bitbang(struct mii_bus *bus)
+{
+}
+
+int mdiobus_register(struct mii_bus *bus)
+{
+	return 0;
+}
+
+void mdiobus_unregister(struct mii_bus *bus)
+{
+}
+
+struct phy_device *phy_find_first(struct mii_bus *bus)
+{
+	int addr, id;
+
+	if (!kshim_phy_mdio)
+		return &kshim_phy;
+
+	for (addr = 0; addr < PHY_MAX_ADDR; addr++) {
+		id = kshim_mdio_read(addr, MII_PHYSID1);
+		if (id != 0xffff && id != 0) {
+			kshim_phy.addr = addr;
+			return &kshim_phy;
+		}
+	}
+	return NULL;
+}
+
+int phy_connect_direct(struct net_device *dev, struct phy_device *phy,
+		       void (*handler)(struct net_device *), int iface)
+{
+	phy->attached = dev;
+	phy->adjust_link = handler;
+	phy->dev.init_name = "kshim-phy";
+	return 0;
+}
+
+void phy_disconnect(struct phy_device *phy)
+{
+	phy->attached = NULL;
+	phy->adjust_link = NULL;
+}
+
+/* what the phylib state machine does on a link change */
+static void kshim_phy_update(struct phy_device *phy)
+{
+	if (!phy->attached)
+		return;
+	if (phy->link)
+		netif_carrier_on(phy->attached);
+	else
+		netif_carrier_off(phy->attached);
+	if (phy->adjust_link)
+		phy->adjust_link(phy->attached);
+}
+
+void phy_start(struct phy_device *phy)
+{
+	kshim_phy_read_status(phy);
+	kshim_phy_update(phy);
+}
+
+void phy_stop(struct phy_device *phy)
+{
+	if (phy->attached)
+		netif_carrier_off(phy->attached);
+}
+
+void phy_print_status(struct phy_device *phy)
+{
+	kshim_printk(KS_INFO, phy->attached ? phy->attached->name : "",
+		     phy->link ? "Link is Up - %dMbps/%s\n" : "Link is Down\n",
+		     phy->speed, phy->duplex == DUPLEX_FULL ? "Full" : "Half");
+}
+
+void phy_mac_interrupt(struct phy_device *phy, int new_link)
+{
+	phy->link = new_link;
+	kshim_phy_read_status(phy);
+	kshim_phy_update(phy);
+}
+
+int phy_mii_ioctl(struct phy_device *phy, struct ifreq *ifr, int cmd)
+{
+	return -EOPNOTSUPP;
+}
+
+int phy_ethtool_gset(struct phy_device *phy, struct ethtool_cmd *cmd)
+{
+	return 0;
+}
+
+int phy_ethtool_sset(struct phy_device *phy, struct ethtool_cmd *cmd)
+{
+	return -EOPNOTSUPP;
+}
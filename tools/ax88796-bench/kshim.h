@@ -0,0 +1,841 @@
+/*
+ * Just enough of the kernel to run ax88796.c and lib8390.c in userspace,
+ * for ax88796-bench. Force-included ahead of the driver; the <linux/...>
+ * headers the driver names are generated empty by the Makefile.
+ *
+ * Locks are free since everything runs on one thread. Interrupts are
+ * not: the shim tracks local_irq and disable_irq state and only lets the
+ * harness deliver an interrupt where the kernel could, including in the
+ * middle of a register access sequence. Work items run when the harness
+ * gets to them. Time is the model's bus clock.
+ */
+#ifndef _KSHIM_H
+#define _KSHIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* glibc always defines both; the driver wants the kernel's meaning */
+#undef __BIG_ENDIAN
+#undef __LITTLE_ENDIAN
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define __BIG_ENDIAN 4321
+#define le16_to_cpu(x) __builtin_bswap16(x)
+#define htons(x) ((uint16_t)(x))
+#else
+#define __LITTLE_ENDIAN 1234
+#define le16_to_cpu(x) ((uint16_t)(x))
+#define htons(x) __builtin_bswap16(x)
+#endif
+#define cpu_to_le16(x) le16_to_cpu(x)
+#define ntohs(x) htons(x)
+#define le16_to_cpus(p) (*(p) = le16_to_cpu(*(p)))
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef long long s64;
+typedef uint16_t __le16;
+typedef uint16_t __be16;
+typedef unsigned int gfp_t;
+typedef unsigned short umode_t;
+typedef s64 ktime_t;
+typedef int irqreturn_t;
+typedef int netdev_tx_t;
+typedef u32 phys_addr_t;
+
+#define __iomem
+#define __force
+#define __user
+#define __init
+#define __exit
+#define __read_mostly
+#define ____cacheline_aligned
+#define __maybe_unused __attribute__((unused))
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define barrier() __asm__ __volatile__("" ::: "memory")
+#define mb() barrier()
+#define rmb() barrier()
+#define wmb() barrier()
+#define smp_rmb() barrier()
+#define smp_wmb() barrier()
+#define cpu_relax() barrier()
+#define READ_ONCE(x) (x)
+#define WRITE_ONCE(x, v) ((x) = (v))
+
+#define BIT(n) (1UL << (n))
+#define GENMASK(h, l) (((~0UL) << (l)) & (~0UL >> (8 * sizeof(long) - 1 - (h))))
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define DIV_ROUND_UP(a, b) (((a) + (b) - 1) / (b))
+#define container_of(p, t, m) ((t *)((char *)(p) - offsetof(t, m)))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min_t(t, a, b) ((t)(a) < (t)(b) ? (t)(a) : (t)(b))
+#define max_t(t, a, b) ((t)(a) > (t)(b) ? (t)(a) : (t)(b))
+#define clamp_t(t, v, l, h) min_t(t, max_t(t, v, l), h)
+#define fls(x) ((x) ? 32 - __builtin_clz(x) : 0)
+#define fls64(x) ((x) ? 64 - __builtin_clzll(x) : 0)
+#define ilog2(n) (fls(n) - 1)
+#define U32_MAX 0xffffffffU
+#define BUILD_BUG_ON(c) ((void)sizeof(char[1 - 2 * !!(c)]))
+#define WARN_ON_ONCE(c) ({ bool __c = !!(c); if (__c) kshim_warn(__FILE__, __LINE__); __c; })
+#define IS_ENABLED(x) 0
+
+#define EIO		5
+#define ENXIO		6
+#define EAGAIN		11
+#define ENOMEM		12
+#define EBUSY		16
+#define ENODEV		19
+#define EINVAL		22
+#define ENETDOWN	100
+#define EOPNOTSUPP	95
+#define ETIMEDOUT	110
+
+#define GFP_KERNEL	0
+#define GFP_ATOMIC	1
+#define PAGE_SIZE	4096
+#define PAGE_ALIGN(x)	(((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1UL))
+#define S_IRUGO		0444
+#define S_IWUSR		0200
+#define THIS_MODULE	NULL
+#define KBUILD_MODNAME	"ax88796"
+
+/* module glue: the harness calls ax_init_module() itself */
+#define module_param(n, t, p) extern int kshim_unused
+#define module_param_named(a, n, t, p) extern int kshim_unused
+#define MODULE_PARM_DESC(n, d) extern int kshim_unused
+#define MODULE_DEVICE_TABLE(b, t) extern int kshim_unused
+#define MODULE_DESCRIPTION(x) extern int kshim_unused
+#define MODULE_AUTHOR(x) extern int kshim_unused
+#define MODULE_LICENSE(x) extern int kshim_unused
+#define MODULE_ALIAS(x) extern int kshim_unused
+#define module_init(f) extern int kshim_unused
+#define module_exit(f) extern int kshim_unused
+#define EXPORT_SYMBOL(x) extern int kshim_unused
+
+/* logging */
+enum { KS_ERR, KS_WARN, KS_INFO, KS_DBG };
+extern int kshim_loglevel;
+void kshim_printk(int level, const char *who, const char *fmt, ...);
+void kshim_warn(const char *file, int line);
+#define netdev_err(d, ...) kshim_printk(KS_ERR, (d)->name, __VA_ARGS__)
+#define netdev_warn(d, ...) kshim_printk(KS_WARN, (d)->name, __VA_ARGS__)
+#define netdev_notice(d, ...) kshim_printk(KS_INFO, (d)->name, __VA_ARGS__)
+#define netdev_info(d, ...) kshim_printk(KS_INFO, (d)->name, __VA_ARGS__)
+#define netdev_dbg(d, ...) kshim_printk(KS_DBG, (d)->name, __VA_ARGS__)
+#define dev_err(d, ...) kshim_printk(KS_ERR, dev_name(d), __VA_ARGS__)
+#define dev_warn(d, ...) kshim_printk(KS_WARN, dev_name(d), __VA_ARGS__)
+#define dev_info(d, ...) kshim_printk(KS_INFO, dev_name(d), __VA_ARGS__)
+#define pr_err(...) kshim_printk(KS_ERR, "", __VA_ARGS__)
+#define pr_warn(...) kshim_printk(KS_WARN, "", __VA_ARGS__)
+#define pr_info(...) kshim_printk(KS_INFO, "", __VA_ARGS__)
+#define pr_cont(...) kshim_printk(KS_DBG, NULL, __VA_ARGS__)
+#define printk(...) kshim_printk(KS_DBG, "", __VA_ARGS__)
+void panic(const char *fmt, ...) __attribute__((noreturn));
+
+/* memory and strings */
+#define kmalloc(s, g) malloc(s)
+#define kzalloc(s, g) calloc(1, s)
+#define kcalloc(n, s, g) calloc(n, s)
+#define kfree(p) free((void *)(p))
+#define vzalloc(s) calloc(1, s)
+#define vfree(p) free((void *)(p))
+size_t strlcpy(char *dst, const char *src, size_t size);
+int scnprintf(char *buf, size_t size, const char *fmt, ...);
+void sort(void *base, size_t num, size_t size,
+	  int (*cmp)(const void *, const void *),
+	  void (*swap)(void *, void *, int));
+int kstrtouint(const char *s, unsigned int base, unsigned int *res);
+
+/* time: the model clock, see kshim_now() */
+#define HZ 100
+#define NSEC_PER_USEC	1000L
+#define NSEC_PER_MSEC	1000000L
+#define NSEC_PER_SEC	1000000000L
+#define MSEC_PER_SEC	1000L
+#define jiffies ((unsigned long)(kshim_now() / (NSEC_PER_SEC / HZ)))
+#define time_after(a, b) ((long)((b) - (a)) < 0)
+#define time_before(a, b) time_after(b, a)
+#define msecs_to_jiffies(ms) ((unsigned long)(ms) * HZ / MSEC_PER_SEC)
+#define round_jiffies_relative(j) (j)
+#define ktime_to_ns(k) ((s64)(k))
+#define ns_to_ktime(n) ((ktime_t)(n))
+#define ktime_sub(a, b) ((a) - (b))
+#define ktime_to_us(k) ((s64)(k) / NSEC_PER_USEC)
+#define ktime_get() ((ktime_t)kshim_now())
+#define ktime_get_ns() kshim_now()
+#define ktime_get_real() ((ktime_t)kshim_now())
+#define mdelay(n) kshim_idle((u64)(n) * NSEC_PER_MSEC)
+#define udelay(n) kshim_idle((u64)(n) * NSEC_PER_USEC)
+#define msleep(n) kshim_sleep((u64)(n) * NSEC_PER_MSEC)
+#define usleep_range(a, b) kshim_sleep((u64)(a) * NSEC_PER_USEC)
+static inline u64 div64_u64(u64 a, u64 b) { return a / b; }
+static inline u64 div_u64(u64 a, u32 b) { return a / b; }
+
+/* provided by the harness */
+u64 kshim_now(void);
+void kshim_idle(u64 ns);	/* busy wait: the clock runs, nothing else */
+bool kshim_irq_asserted(int irq);
+
+void kshim_sleep(u64 ns);	/* process context: work and interrupts run */
+
+/* lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD(n) struct list_head n = { &(n), &(n) }
+#define list_entry(p, t, m) container_of(p, t, m)
+#define list_for_each_entry(p, h, m)					\
+	for (p = list_entry((h)->next, __typeof__(*p), m); &p->m != (h);	\
+	     p = list_entry(p->m.next, __typeof__(*p), m))
+
+static inline void INIT_LIST_HEAD(struct list_head *h)
+{
+	h->next = h->prev = h;
+}
+
+static inline void list_add_tail(struct list_head *n, struct list_head *h)
+{
+	n->prev = h->prev;
+	n->next = h;
+	h->prev->next = n;
+	h->prev = n;
+}
+
+static inline void list_del(struct list_head *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	n->next = n->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *h)
+{
+	return h->next == h;
+}
+
+/* locking and interrupts */
+typedef struct { int unused; } spinlock_t;
+struct mutex { int unused; };
+
+#define DEFINE_SPINLOCK(n) spinlock_t n = { 0 }
+#define DEFINE_MUTEX(n) struct mutex n = { 0 }
+#define spin_lock_init(l) ((void)(l))
+#define spin_lock(l) ((void)(l))
+#define spin_unlock(l) ((void)(l))
+#define spin_lock_bh(l) ((void)(l))
+#define spin_unlock_bh(l) ((void)(l))
+#define spin_lock_irqsave(l, f) ((void)(l), (f) = kshim_irq_save())
+#define spin_unlock_irqrestore(l, f) ((void)(l), kshim_irq_restore(f))
+#define local_irq_save(f) ((f) = kshim_irq_save())
+#define local_irq_restore(f) kshim_irq_restore(f)
+#define local_bh_disable() do { } while (0)
+#define local_bh_enable() do { } while (0)
+#define mutex_init(m) ((void)(m))
+#define mutex_lock(m) ((void)(m))
+#define mutex_unlock(m) ((void)(m))
+
+#define IRQF_SHARED	0x80
+#define IRQ_NONE	0
+#define IRQ_HANDLED	1
+#define IRQ_RETVAL(x)	((x) ? IRQ_HANDLED : IRQ_NONE)
+
+unsigned long kshim_irq_save(void);
+void kshim_irq_restore(unsigned long flags);
+int request_irq(int irq, irqreturn_t (*handler)(int, void *),
+		unsigned long flags, const char *name, void *dev_id);
+void free_irq(int irq, void *dev_id);
+void disable_irq_nosync(int irq);
+void enable_irq(int irq);
+#define disable_irq(i) disable_irq_nosync(i)
+#define synchronize_irq(i) ((void)(i))
+#define disable_irq_nosync_lockdep(i) disable_irq_nosync(i)
+#define enable_irq_lockdep(i) enable_irq(i)
+#define disable_irq_nosync_lockdep_irqsave(i, f) ((void)(f), disable_irq_nosync(i))
+#define enable_irq_lockdep_irqrestore(i, f) ((void)(f), enable_irq(i))
+
+/* the harness raises an interrupt through this when the line is asserted */
+void kshim_irq(int irq);
+
+/* work queues */
+struct workqueue_struct;
+struct work_struct {
+	void (*func)(struct work_struct *);
+	struct list_head entry;
+	bool pending;
+	u64 due;
+};
+
+struct delayed_work {
+	struct work_struct work;
+};
+
+extern struct workqueue_struct *system_wq, *system_highpri_wq;
+
+void kshim_init_work(struct work_struct *w, void (*func)(struct work_struct *));
+#define INIT_WORK(w, f) kshim_init_work(w, f)
+#define INIT_DELAYED_WORK(w, f) kshim_init_work(&(w)->work, f)
+#define to_delayed_work(w) container_of(w, struct delayed_work, work)
+bool queue_work(struct workqueue_struct *wq, struct work_struct *w);
+#define schedule_work(w) queue_work(system_wq, w)
+bool schedule_delayed_work(struct delayed_work *dw, unsigned long delay);
+bool flush_work(struct work_struct *w);
+bool cancel_work_sync(struct work_struct *w);
+#define cancel_delayed_work_sync(dw) cancel_work_sync(&(dw)->work)
+
+/* run what is due; returns how many ran */
+int kshim_run_work(void);
+u64 kshim_next_work(void);
+
+/* devices */
+struct device_driver {
+	const char *name;
+	int probe_type;
+};
+#define PROBE_PREFER_ASYNCHRONOUS 1
+
+struct device {
+	struct device *parent;
+	void *driver_data;
+	const char *init_name;
+};
+
+static inline const char *dev_name(const struct device *d)
+{
+	return d && d->init_name ? d->init_name : "";
+}
+
+struct attribute {
+	const char *name;
+	umode_t mode;
+};
+
+struct device_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct device *, struct device_attribute *, char *);
+	ssize_t (*store)(struct device *, struct device_attribute *,
+			 const char *, size_t);
+};
+
+#define DEVICE_ATTR(n, m, s, st) \
+	struct device_attribute dev_attr_##n = { { #n, m }, s, st }
+
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+};
+
+struct resource {
+	unsigned long start, end;
+};
+
+/* debugfs, accepted and dropped; seq_file prints where the harness says */
+struct dentry;
+struct inode {
+	void *i_private;
+};
+struct file {
+	void *private_data;
+};
+struct seq_file {
+	void *private;
+	FILE *out;			/* NULL: dropped */
+};
+
+struct file_operations {
+	void *owner;
+	int (*open)(struct inode *, struct file *);
+	ssize_t (*read)(struct file *, char *, size_t, loff_t *);
+	ssize_t (*write)(struct file *, const char *, size_t, loff_t *);
+	loff_t (*llseek)(struct file *, loff_t, int);
+	int (*release)(struct inode *, struct file *);
+};
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+struct dentry *debugfs_create_file(const char *name, umode_t mode,
+				   struct dentry *parent, void *data,
+				   const struct file_operations *fops);
+void debugfs_remove_recursive(struct dentry *d);
+int seq_printf(struct seq_file *m, const char *fmt, ...);
+int seq_puts(struct seq_file *m, const char *s);
+int single_open(struct file *f, int (*show)(struct seq_file *, void *), void *d);
+int single_release(struct inode *i, struct file *f);
+ssize_t seq_read(struct file *f, char *buf, size_t n, loff_t *pos);
+loff_t seq_lseek(struct file *f, loff_t off, int whence);
+
+/* fault injection, driven by the harness's -F option */
+struct fault_attr {
+	unsigned long probability;	/* percent */
+	unsigned long interval;
+	long times;			/* -1: no limit */
+	unsigned long count;
+};
+#define FAULT_ATTR_INITIALIZER { .probability = 0, .interval = 1, .times = -1 }
+bool should_fail(struct fault_attr *attr, ssize_t size);
+struct dentry *fault_create_debugfs_attr(const char *name,
+					 struct dentry *parent,
+					 struct fault_attr *attr);
+
+/* sk_buff */
+#define SKBTX_SW_TSTAMP		(1 << 1)
+#define SKBTX_IN_PROGRESS	(1 << 2)
+
+struct skb_shared_info {
+	u8 tx_flags;
+};
+
+struct skb_shared_hwtstamps {
+	ktime_t hwtstamp;
+};
+
+struct sk_buff {
+	struct sk_buff *next, *prev;	/* first, as in sk_buff_head */
+	unsigned char *head, *data;
+	unsigned int len, size;
+	unsigned short protocol;
+	unsigned short queue_mapping;
+	unsigned int priority;
+	ktime_t tstamp;
+	bool xmit_more;
+	struct skb_shared_info shinfo;
+};
+
+struct sk_buff_head {
+	struct sk_buff *next, *prev;
+	u32 qlen;
+};
+
+#define skb_shinfo(skb) (&(skb)->shinfo)
+#define NET_SKB_PAD 32
+
+struct net_device;
+struct sk_buff *netdev_alloc_skb(struct net_device *dev, unsigned int len);
+void kfree_skb(struct sk_buff *skb);
+#define dev_kfree_skb(s) kfree_skb(s)
+#define dev_kfree_skb_any(s) kfree_skb(s)
+#define dev_kfree_skb_irq(s) kfree_skb(s)
+#define dev_consume_skb_any(s) kfree_skb(s)
+
+static inline void skb_reserve(struct sk_buff *skb, int n)
+{
+	skb->data += n;
+}
+
+static inline unsigned char *skb_put(struct sk_buff *skb, unsigned int n)
+{
+	unsigned char *p = skb->data + skb->len;
+
+	skb->len += n;
+	if (skb->data + skb->len > skb->head + skb->size)
+		panic("skb_put over the end\n");
+	return p;
+}
+
+static inline u16 skb_get_queue_mapping(const struct sk_buff *skb)
+{
+	return skb->queue_mapping;
+}
+
+static inline void __skb_queue_head_init(struct sk_buff_head *l)
+{
+	l->next = l->prev = (struct sk_buff *)l;
+	l->qlen = 0;
+}
+#define skb_queue_head_init(l) __skb_queue_head_init(l)
+
+static inline void __skb_queue_tail(struct sk_buff_head *l, struct sk_buff *s)
+{
+	s->next = (struct sk_buff *)l;
+	s->prev = l->prev;
+	l->prev->next = s;
+	l->prev = s;
+	l->qlen++;
+}
+#define skb_queue_tail(l, s) __skb_queue_tail(l, s)
+
+static inline struct sk_buff *skb_peek(const struct sk_buff_head *l)
+{
+	return l->next == (const struct sk_buff *)l ? NULL : l->next;
+}
+
+static inline void skb_unlink(struct sk_buff *s, struct sk_buff_head *l)
+{
+	s->prev->next = s->next;
+	s->next->prev = s->prev;
+	s->next = s->prev = NULL;
+	l->qlen--;
+}
+
+static inline struct sk_buff *__skb_dequeue(struct sk_buff_head *l)
+{
+	struct sk_buff *s = skb_peek(l);
+
+	if (s)
+		skb_unlink(s, l);
+	return s;
+}
+#define skb_dequeue(l) __skb_dequeue(l)
+
+static inline u32 skb_queue_len(const struct sk_buff_head *l)
+{
+	return l->qlen;
+}
+
+static inline int skb_queue_empty(const struct sk_buff_head *l)
+{
+	return l->next == (const struct sk_buff *)l;
+}
+
+static inline void skb_queue_purge(struct sk_buff_head *l)
+{
+	struct sk_buff *s;
+
+	while ((s = __skb_dequeue(l)) != NULL)
+		kfree_skb(s);
+}
+
+void skb_tx_timestamp(struct sk_buff *skb);
+void skb_clone_tx_timestamp(struct sk_buff *skb);
+void skb_tstamp_tx(struct sk_buff *skb, struct skb_shared_hwtstamps *hw);
+#define skb_defer_rx_timestamp(skb) false
+
+/* net_device */
+#define ETH_ALEN	6
+#define ETH_HLEN	14
+#define ETH_ZLEN	60
+#define ETH_FRAME_LEN	1514
+#define ETH_GSTRING_LEN	32
+#define IFF_BROADCAST	0x2
+#define IFF_PROMISC	0x100
+#define IFF_ALLMULTI	0x200
+#define IFF_MULTICAST	0x1000
+#define NETDEV_TX_OK	0
+#define NETDEV_TX_BUSY	0x10
+#define TC_PRIO_INTERACTIVE	6
+#define TC_PRIO_CONTROL		7
+
+struct net_device_stats {
+	unsigned long rx_packets, tx_packets, rx_bytes, tx_bytes;
+	unsigned long rx_errors, tx_errors, rx_dropped, tx_dropped;
+	unsigned long multicast, collisions;
+	unsigned long rx_length_errors, rx_over_errors, rx_crc_errors;
+	unsigned long rx_frame_errors, rx_fifo_errors, rx_missed_errors;
+	unsigned long tx_aborted_errors, tx_carrier_errors, tx_fifo_errors;
+	unsigned long tx_heartbeat_errors, tx_window_errors;
+};
+
+struct netdev_hw_addr {
+	unsigned char addr[ETH_ALEN];
+};
+
+struct ifreq;
+struct ethtool_cmd;
+struct ethtool_ts_info;
+
+struct ethtool_drvinfo {
+	char driver[32], version[32], bus_info[32];
+};
+
+#define ETH_SS_TEST		0
+#define ETH_SS_STATS		1
+#define ETH_TEST_FL_OFFLINE	(1 << 0)
+#define ETH_TEST_FL_FAILED	(1 << 1)
+
+struct ethtool_test {
+	u32 cmd, flags, reserved, len;
+};
+
+struct ethtool_stats {
+	u32 cmd, n_stats;
+};
+
+struct net_device_ops {
+	int (*ndo_open)(struct net_device *);
+	int (*ndo_stop)(struct net_device *);
+	int (*ndo_do_ioctl)(struct net_device *, struct ifreq *, int);
+	netdev_tx_t (*ndo_start_xmit)(struct sk_buff *, struct net_device *);
+	void (*ndo_tx_timeout)(struct net_device *);
+	struct net_device_stats *(*ndo_get_stats)(struct net_device *);
+	void (*ndo_set_rx_mode)(struct net_device *);
+	int (*ndo_validate_addr)(struct net_device *);
+	int (*ndo_set_mac_address)(struct net_device *, void *);
+	int (*ndo_change_mtu)(struct net_device *, int);
+	void (*ndo_poll_controller)(struct net_device *);
+};
+
+struct ethtool_ops {
+	void (*get_drvinfo)(struct net_device *, struct ethtool_drvinfo *);
+	int (*get_settings)(struct net_device *, struct ethtool_cmd *);
+	int (*set_settings)(struct net_device *, struct ethtool_cmd *);
+	u32 (*get_link)(struct net_device *);
+	int (*get_ts_info)(struct net_device *, struct ethtool_ts_info *);
+	int (*get_sset_count)(struct net_device *, int);
+	void (*get_strings)(struct net_device *, u32, u8 *);
+	void (*get_ethtool_stats)(struct net_device *, struct ethtool_stats *,
+				  u64 *);
+	void (*self_test)(struct net_device *, struct ethtool_test *, u64 *);
+};
+
+/* net_device.state */
+#define KSHIM_REGISTERED	BIT(0)
+#define KSHIM_RUNNING		BIT(1)
+#define KSHIM_CARRIER		BIT(2)
+
+struct net_device {
+	char name[16];
+	unsigned long base_addr;
+	int irq;
+	int watchdog_timeo;
+	unsigned char dev_addr[ETH_ALEN];
+	unsigned int flags;
+	struct net_device_stats stats;
+	struct device dev;
+	const struct net_device_ops *netdev_ops;
+	const struct ethtool_ops *ethtool_ops;
+	unsigned long trans_start;
+	const struct attribute_group *sysfs_groups[4];
+	unsigned int num_tx_queues;
+	unsigned int real_num_tx_queues;
+	unsigned long state;
+	unsigned long tx_stopped;	/* one bit per Tx queue */
+};
+
+#define NETDEV_ALIGN 32
+#define netdev_priv(d) ((void *)((char *)(d) + \
+	((sizeof(struct net_device) + NETDEV_ALIGN - 1) & ~(NETDEV_ALIGN - 1))))
+#define SET_NETDEV_DEV(n, d) ((n)->dev.parent = (d))
+#define to_net_dev(d) container_of(d, struct net_device, dev)
+#define netdev_for_each_mc_addr(ha, d) for ((ha) = NULL; (ha); )
+
+struct net_device *alloc_netdev_mqs(int sizeof_priv, const char *name,
+				    void (*setup)(struct net_device *),
+				    unsigned int txqs, unsigned int rxqs);
+void free_netdev(struct net_device *dev);
+int register_netdev(struct net_device *dev);
+void unregister_netdev(struct net_device *dev);
+void ether_setup(struct net_device *dev);
+
+static inline bool netif_running(const struct net_device *dev)
+{
+	return dev->state & KSHIM_RUNNING;
+}
+
+static inline void netif_carrier_on(struct net_device *dev)
+{
+	dev->state |= KSHIM_CARRIER;
+}
+
+static inline void netif_carrier_off(struct net_device *dev)
+{
+	dev->state &= ~KSHIM_CARRIER;
+}
+
+static inline bool netif_carrier_ok(const struct net_device *dev)
+{
+	return dev->state & KSHIM_CARRIER;
+}
+
+static inline void netif_tx_start_all_queues(struct net_device *dev)
+{
+	dev->tx_stopped = 0;
+}
+#define netif_tx_wake_all_queues(d) netif_tx_start_all_queues(d)
+#define netif_start_queue(d) netif_tx_start_all_queues(d)
+#define netif_wake_queue(d) netif_tx_start_all_queues(d)
+
+static inline void netif_tx_stop_all_queues(struct net_device *dev)
+{
+	dev->tx_stopped = ~0UL;
+}
+#define netif_tx_disable(d) netif_tx_stop_all_queues(d)
+#define netif_stop_queue(d) netif_tx_stop_all_queues(d)
+
+static inline void netif_stop_subqueue(struct net_device *dev, u16 q)
+{
+	dev->tx_stopped |= BIT(q);
+}
+
+static inline void netif_wake_subqueue(struct net_device *dev, u16 q)
+{
+	dev->tx_stopped &= ~BIT(q);
+}
+
+static inline bool __netif_subqueue_stopped(const struct net_device *dev,
+					    u16 q)
+{
+	return dev->tx_stopped & BIT(q);
+}
+
+#define netif_device_attach(d) ((void)(d))
+#define netif_device_detach(d) ((void)(d))
+#define netdev_mc_empty(d) true
+#define dev_trans_start(d) ((d)->trans_start)
+
+static inline int netdev_set_num_tc(struct net_device *d, u8 n) { return 0; }
+static inline int netdev_set_tc_queue(struct net_device *d, u8 tc, u16 n,
+				      u16 off) { return 0; }
+static inline int netdev_set_prio_tc_map(struct net_device *d, u8 p, u8 tc)
+{ return 0; }
+
+int netif_rx(struct sk_buff *skb);
+unsigned short eth_type_trans(struct sk_buff *skb, struct net_device *dev);
+int eth_validate_addr(struct net_device *dev);
+int eth_mac_addr(struct net_device *dev, void *p);
+int eth_change_mtu(struct net_device *dev, int mtu);
+u32 ether_crc(int len, const unsigned char *data);
+u32 ethtool_op_get_link(struct net_device *dev);
+int ethtool_op_get_ts_info(struct net_device *dev, struct ethtool_ts_info *i);
+
+static inline bool is_valid_ether_addr(const u8 *a)
+{
+	static const u8 zero[ETH_ALEN];
+
+	return !(a[0] & 1) && memcmp(a, zero, ETH_ALEN);
+}
+
+/*
+ * phylib and MDIO bitbanging: one PHY, up at 100/full, unless the
+ * harness sets kshim_phy_mdio to have it read over the driver's bitbang
+ * ops instead
+ */
+#define PHY_POLL		-1
+#define PHY_IGNORE_INTERRUPT	-2
+#define PHY_MAX_ADDR		32
+#define PHY_BASIC_FEATURES	0x2ff
+#define PHY_INTERFACE_MODE_MII	1
+#define MII_BUS_ID_SIZE		61
+#define DUPLEX_HALF		0
+#define DUPLEX_FULL		1
+#define SPEED_10		10
+#define SPEED_100		100
+
+struct phy_driver {
+	const char *name;
+};
+
+struct phy_device {
+	int addr, link, speed, duplex, irq;
+	u32 supported, advertising;
+	struct device dev;
+	const struct phy_driver *drv;
+	struct net_device *attached;
+	void (*adjust_link)(struct net_device *);
+};
+
+struct mii_bus {
+	const char *name;
+	struct device *parent;
+	char id[MII_BUS_ID_SIZE];
+	int *irq;
+	void *priv;
+};
+
+struct mdiobb_ctrl {
+	const struct mdiobb_ops *ops;
+};
+
+struct mdiobb_ops {
+	void *owner;
+	void (*set_mdc)(struct mdiobb_ctrl *, int);
+	void (*set_mdio_dir)(struct mdiobb_ctrl *, int);
+	void (*set_mdio_data)(struct mdiobb_ctrl *, int);
+	int (*get_mdio_data)(struct mdiobb_ctrl *);
+};
+
+struct mii_bus *alloc_mdio_bitbang(struct mdiobb_ctrl *ctrl);
+void free_mdio_bitbang(struct mii_bus *bus);
+int mdiobus_register(struct mii_bus *bus);
+void mdiobus_unregister(struct mii_bus *bus);
+struct phy_device *phy_find_first(struct mii_bus *bus);
+int phy_connect_direct(struct net_device *dev, struct phy_device *phy,
+		       void (*handler)(struct net_device *), int iface);
+void phy_disconnect(struct phy_device *phy);
+void phy_start(struct phy_device *phy);
+void phy_stop(struct phy_device *phy);
+void phy_print_status(struct phy_device *phy);
+void phy_mac_interrupt(struct phy_device *phy, int new_link);
+int phy_mii_ioctl(struct phy_device *phy, struct ifreq *ifr, int cmd);
+int phy_ethtool_gset(struct phy_device *phy, struct ethtool_cmd *cmd);
+int phy_ethtool_sset(struct phy_device *phy, struct ethtool_cmd *cmd);
+
+/* harness hooks: the PHY, for link change scenarios, or a real one */
+extern struct phy_device kshim_phy;
+extern bool kshim_phy_mdio;
+
+/* Zorro bus; the board itself is provided by the harness */
+#define ZORRO_MANUF_INDIVIDUAL_COMPUTERS 0x1212
+#define ZORRO_ID(manuf, prod, epc) \
+	((ZORRO_MANUF_##manuf << 16) | ((prod) << 8) | (epc))
+#define IRQ_AMIGA_PORTS 2
+
+struct zorro_dev {
+	struct resource resource;
+	unsigned int id;
+	struct device dev;
+};
+
+struct zorro_device_id {
+	unsigned int id;
+	unsigned long driver_data;
+};
+
+struct zorro_driver {
+	const char *name;
+	const struct zorro_device_id *id_table;
+	int (*probe)(struct zorro_dev *, const struct zorro_device_id *);
+	void (*remove)(struct zorro_dev *);
+	struct device_driver driver;
+};
+
+#define to_zorro_dev(d) container_of(d, struct zorro_dev, dev)
+#define zorro_set_drvdata(z, p) ((z)->dev.driver_data = (p))
+#define zorro_get_drvdata(z) ((z)->dev.driver_data)
+
+int zorro_register_driver(struct zorro_driver *drv);
+void zorro_unregister_driver(struct zorro_driver *drv);
+void *request_mem_region(unsigned long start, unsigned long n, const char *name);
+void release_mem_region(unsigned long start, unsigned long n);
+void *z_ioremap(unsigned long phys, unsigned long size);
+void z_iounmap(void *addr);
+
+/* <net/ax88796.h> */
+#define AXFLG_HAS_EEPROM	(1 << 0)
+#define AXFLG_MAC_FROMDEV	(1 << 1)
+#define AXFLG_HAS_93CX6		(1 << 2)
+#define AXFLG_MAC_FROMPLATFORM	(1 << 3)
+
+struct ax_plat_data {
+	unsigned int flags;
+	unsigned char wordlength;
+	unsigned char dcr_val;
+	unsigned char rcr_val;
+	unsigned char gpoc_val;
+	unsigned char *mac_addr;
+};
+
+/* counters the shim keeps for the harness */
+struct kshim_stats {
+	u64 irqs;			/* handler runs */
+	u64 irqs_unhandled;		/* line asserted, nobody claimed it */
+	u64 tx_stamped;			/* skb_tstamp_tx() calls */
+	u64 skbs;			/* allocated and not yet freed */
+};
+extern struct kshim_stats kshim_stats;
+
+/* the harness's stack: receives what netif_rx() is handed */
+void kshim_rx(struct sk_buff *skb);
+
+int kshim_dev_open(struct net_device *dev);
+void kshim_dev_close(struct net_device *dev);
+
+#endif
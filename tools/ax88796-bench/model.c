@@ -0,0 +1,641 @@
+/*
+ * Software model of an AX88796 on an X-Surf 100, for ax88796-bench.
+ *
+ * Covers what the driver core relies on: the three register pages, the
+ * remote DMA engine behind the data port and the 32-bit FIFO windows,
+ * the receive ring with CURPAG/BOUNDARY and overflow, the transmitter
+ * with internal loopback, ISR/IMR and the interrupt line, the counter
+ * registers, the station address PROM, MEMR and GPI. It does not model
+ * MDIO, collisions or half duplex.
+ *
+ * Time only moves when the driver touches the bus or the harness idles:
+ * each byte or word access costs one bus cycle, each FIFO longword two,
+ * since the board's FPGA splits it into two 16-bit cycles. Frames from
+ * the wire and Tx completions are applied in time order as the clock
+ * passes them.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "model.h"
+
+#define XS100_IRQSTATUS		0x40
+#define XS100_REGS		0x800
+#define XS100_READ32		(0x8000 + 0x0880)
+#define XS100_WRITE32		(0x8000 + 0x0C80)
+#define XS100_AREA_SIZE		0x80
+
+#define CR_STP		0x01
+#define CR_STA		0x02
+#define CR_TXP		0x04
+#define CR_RD_MASK	0x38
+#define CR_RREAD	0x08
+#define CR_RWRITE	0x10
+
+#define ISR_PRX		0x01
+#define ISR_PTX		0x02
+#define ISR_OVW		0x10
+#define ISR_CNT		0x20
+#define ISR_RDC		0x40
+#define ISR_RST		0x80
+
+#define RCR_AB		0x04
+#define RCR_AM		0x08
+#define RCR_PRO		0x10
+#define RCR_MON		0x20
+#define TCR_LB		0x06
+
+#define RSR_PRX		0x01
+#define RSR_MPA		0x10
+#define RSR_PHY		0x20
+
+#define TSR_PTX		0x01
+
+#define REG_DATA	0x10
+#define REG_MEMR	0x14
+#define REG_GPOC	0x17
+#define REG_RESET	0x1f
+
+#define GPI_LINK_FDX_100	0x07
+
+struct model_stats model_stats;
+void (*model_irq_hook)(void);
+
+static struct {
+	unsigned char *win;		/* only its addresses are handed out */
+	unsigned int cycle_ns;
+	uint64_t now;
+
+	/* 8390 core */
+	uint8_t page, rd, started;
+	uint8_t isr, imr, rcr, tcr, dcr;
+	uint8_t pstart, pstop, bnry, curr, tpsr;
+	uint8_t tsr, rsr, cntr[3];
+	uint8_t par[6], mar[8];
+	uint16_t tbcr, rsar, rbcr;
+
+	/* remote DMA */
+	uint16_t crda, rcnt;
+
+	/* transmitter */
+	bool txing;
+	uint64_t tx_done;
+	uint16_t tx_addr, tx_len;
+
+	/* AX88796 extras */
+	uint8_t memr, gpoc;
+
+	/* local buffer memory: PROM at 0, 16K SRAM at 0x4000 */
+	uint8_t mem[0x10000];
+
+	/* the wire */
+	model_rx_src_t src;
+	model_tx_sink_t sink;
+	void *ctx;
+	bool have_rx;
+	struct model_frame rx;
+} m;
+
+static uint8_t mem_rd(uint16_t a)
+{
+	if (a < 0x20 || (a >= 0x4000 && a < 0x8000))
+		return m.mem[a];
+	return 0xff;
+}
+
+static void mem_wr(uint16_t a, uint8_t v)
+{
+	if (a >= 0x4000 && a < 0x8000)
+		m.mem[a] = v;
+}
+
+static bool irq_line(void)
+{
+	return (m.isr & m.imr & 0x7f) != 0;
+}
+
+static void count(int i)
+{
+	if (m.cntr[i] < 0xff)
+		m.cntr[i]++;
+	if (m.cntr[i] & 0x80)
+		m.isr |= ISR_CNT;
+}
+
+static void missed(void)
+{
+	model_stats.rx_missed++;
+	m.rsr |= RSR_MPA;
+	count(2);
+}
+
+static bool rx_accept(const unsigned char *d)
+{
+	static const unsigned char bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+	if (m.rcr & RCR_PRO)
+		return true;
+	if (!(d[0] & 1))
+		return !memcmp(d, m.par, 6);
+	if (!memcmp(d, bcast, 6))
+		return m.rcr & RCR_AB;
+	/* multicast: hash on the top 6 bits of the FCS, any bit will do here */
+	return (m.rcr & RCR_AM) && (m.mar[0] | m.mar[1] | m.mar[2] | m.mar[3] |
+				     m.mar[4] | m.mar[5] | m.mar[6] | m.mar[7]);
+}
+
+/* one frame into the ring at CURPAG, as the DP8390 stores it */
+static void rx_frame(const unsigned char *d, unsigned int len, bool loop)
+{
+	unsigned int ring = m.pstop - m.pstart;
+	unsigned int total = len + 4, pages = (total + 255) >> 8, free, i;
+	uint16_t a;
+	uint8_t next;
+
+	if (!m.started) {
+		model_stats.rx_stopped++;
+		return;
+	}
+	/* internal loopback is deaf to the wire */
+	if (!loop && (m.tcr & TCR_LB))
+		return;
+	if ((m.rcr & RCR_MON) || !rx_accept(d)) {
+		model_stats.rx_filtered++;
+		return;
+	}
+	if (!ring || m.pstop > 0x80 || m.pstart < 0x40) {
+		missed();
+		return;
+	}
+
+	/* the receiver stays off until the driver has acked an overflow */
+	free = (m.bnry - m.curr + ring) % ring;
+	if ((m.isr & ISR_OVW) || pages > free) {
+		if (!(m.isr & ISR_OVW))
+			model_stats.overflows++;
+		m.isr |= ISR_OVW;
+		missed();
+		return;
+	}
+
+	next = m.curr + pages;
+	if (next >= m.pstop)
+		next -= ring;
+	m.rsr = RSR_PRX | ((d[0] & 1) ? RSR_PHY : 0);
+
+	a = m.curr << 8;
+	mem_wr(a, m.rsr);
+	mem_wr(a + 1, next);
+	mem_wr(a + 2, total & 0xff);
+	mem_wr(a + 3, total >> 8);
+	a += 4;
+	for (i = 0; i < len; i++, a++) {
+		if (a >= m.pstop << 8)
+			a = m.pstart << 8;
+		mem_wr(a, d[i]);
+	}
+
+	m.curr = next;
+	m.isr |= ISR_PRX;
+	model_stats.rx_ring++;
+}
+
+static void tx_complete(void)
+{
+	unsigned char buf[MODEL_FRAME_MAX];
+	unsigned int len = m.tx_len, i;
+
+	if (len > sizeof(buf))
+		len = sizeof(buf);
+	for (i = 0; i < len; i++)
+		buf[i] = mem_rd(m.tx_addr + i);
+
+	m.txing = false;
+	m.tsr = TSR_PTX;
+	m.isr |= ISR_PTX;
+
+	if (m.tcr & TCR_LB) {
+		model_stats.tx_loop++;
+		rx_frame(buf, len, true);
+	} else {
+		model_stats.tx_wire++;
+		if (m.sink)
+			m.sink(m.ctx, buf, len, m.now);
+	}
+}
+
+static void rx_fetch(void)
+{
+	m.have_rx = m.src && m.src(m.ctx, &m.rx);
+}
+
+/* apply everything that happens on the wire up to @t */
+static void sync(uint64_t t)
+{
+	for (;;) {
+		bool tx = m.txing && m.tx_done <= t;
+		bool rx = m.have_rx && m.rx.t <= t;
+
+		if (tx && (!rx || m.tx_done <= m.rx.t)) {
+			m.now = m.tx_done;
+			tx_complete();
+		} else if (rx) {
+			if (m.rx.t > m.now)
+				m.now = m.rx.t;
+			model_stats.rx_wire++;
+			rx_frame(m.rx.data, m.rx.len, false);
+			rx_fetch();
+		} else {
+			break;
+		}
+	}
+	if (t > m.now)
+		m.now = t;
+}
+
+static void bus(unsigned int cycles)
+{
+	model_stats.cycles += cycles;
+	sync(m.now + (uint64_t)cycles * m.cycle_ns);
+}
+
+static void bus_done(void)
+{
+	if (model_irq_hook && irq_line())
+		model_irq_hook();
+}
+
+static void reset(void)
+{
+	model_stats.resets++;
+	if (m.txing)
+		model_stats.tx_lost++;
+	m.txing = false;
+	m.started = 0;
+	m.page = 0;
+	m.rd = 0x20;
+	m.isr = ISR_RST;
+	m.imr = 0;
+	m.rcnt = 0;
+}
+
+static void dma_start(void)
+{
+	m.crda = m.rsar;
+	m.rcnt = m.rbcr;
+	if ((m.rd & (CR_RREAD | CR_RWRITE)) && !m.rcnt)
+		m.isr |= ISR_RDC;
+}
+
+static bool dma_active(uint8_t dir)
+{
+	return (m.rd & 0x20) == 0 && (m.rd & dir) && m.rcnt;
+}
+
+static void dma_step(void)
+{
+	if (--m.rcnt == 0) {
+		m.isr |= ISR_RDC;
+		m.rd = 0x20;
+	}
+}
+
+static uint8_t dma_in(void)
+{
+	uint8_t v;
+
+	if (!dma_active(CR_RREAD)) {
+		model_stats.dma_stray++;
+		return 0xff;
+	}
+	v = mem_rd(m.crda++);
+	if (m.crda == m.pstop << 8)
+		m.crda = m.pstart << 8;
+	dma_step();
+	return v;
+}
+
+static void dma_out(uint8_t v)
+{
+	if (!dma_active(CR_RWRITE)) {
+		model_stats.dma_stray++;
+		return;
+	}
+	mem_wr(m.crda++, v);
+	dma_step();
+}
+
+static uint8_t cr_read(void)
+{
+	return m.page << 6 | m.rd | (m.txing ? CR_TXP : 0) |
+	       (m.started ? CR_STA : CR_STP);
+}
+
+static void cr_write(uint8_t v)
+{
+	m.page = v >> 6;
+	if (v & CR_STP) {
+		m.started = 0;
+		m.isr |= ISR_RST;
+	} else if (v & CR_STA) {
+		m.started = 1;
+		m.isr &= ~ISR_RST;
+	}
+
+	m.rd = v & CR_RD_MASK;
+	if (m.rd & 0x20)
+		m.rd = 0x20;		/* abort/complete remote DMA */
+	else if (m.rd & (CR_RREAD | CR_RWRITE))
+		dma_start();
+
+	if ((v & CR_TXP) && m.started && !m.txing) {
+		m.txing = true;
+		m.tx_addr = m.tpsr << 8;
+		m.tx_len = m.tbcr;
+		m.tx_done = m.now + model_wire_ns(m.tbcr);
+	}
+}
+
+static uint8_t reg_read(unsigned int n)
+{
+	uint8_t v;
+
+	if (n == 0)
+		return cr_read();
+	if (n == REG_DATA)
+		return dma_in();
+	if (n == REG_MEMR)
+		return m.memr;
+	if (n == REG_GPOC)
+		return GPI_LINK_FDX_100;
+	if (n == REG_RESET) {
+		reset();
+		return 0;
+	}
+	if (n > 0x0f)
+		return 0;
+
+	switch (m.page) {
+	case 0:
+		switch (n) {
+		case 0x03: return m.bnry;
+		case 0x04: return m.tsr;
+		case 0x07: return m.isr;
+		case 0x08: return m.crda & 0xff;
+		case 0x09: return m.crda >> 8;
+		case 0x0c: return m.rsr;
+		case 0x0d: case 0x0e: case 0x0f:
+			v = m.cntr[n - 0x0d];
+			m.cntr[n - 0x0d] = 0;
+			return v;
+		}
+		return 0;
+	case 1:
+		if (n <= 6)
+			return m.par[n - 1];
+		if (n == 7)
+			return m.curr;
+		return m.mar[n - 8];
+	case 2:
+		switch (n) {
+		case 0x01: return m.pstart;
+		case 0x02: return m.pstop;
+		case 0x04: return m.tpsr;
+		case 0x0c: return m.rcr;
+		case 0x0d: return m.tcr;
+		case 0x0e: return m.dcr;
+		case 0x0f: return m.imr;
+		}
+		return 0;
+	}
+	return 0;
+}
+
+static void reg_write(unsigned int n, uint8_t v)
+{
+	if (n == 0) {
+		cr_write(v);
+		return;
+	}
+	if (n == REG_DATA) {
+		dma_out(v);
+		return;
+	}
+	if (n == REG_MEMR) {
+		m.memr = v;
+		return;
+	}
+	if (n == REG_GPOC) {
+		m.gpoc = v;
+		return;
+	}
+	if (n == REG_RESET) {
+		reset();
+		return;
+	}
+	if (n > 0x0f)
+		return;
+
+	if (m.page == 1) {
+		if (n <= 6)
+			m.par[n - 1] = v;
+		else if (n == 7)
+			m.curr = v;
+		else
+			m.mar[n - 8] = v;
+		return;
+	}
+	if (m.page != 0)
+		return;
+
+	switch (n) {
+	case 0x01: m.pstart = v; break;
+	case 0x02: m.pstop = v; break;
+	case 0x03: m.bnry = v; break;
+	case 0x04: m.tpsr = v; break;
+	case 0x05: m.tbcr = (m.tbcr & 0xff00) | v; break;
+	case 0x06: m.tbcr = (m.tbcr & 0x00ff) | v << 8; break;
+	case 0x07: m.isr &= ~v; break;
+	case 0x08: m.rsar = (m.rsar & 0xff00) | v; m.crda = m.rsar; break;
+	case 0x09: m.rsar = (m.rsar & 0x00ff) | v << 8; m.crda = m.rsar; break;
+	case 0x0a: m.rbcr = (m.rbcr & 0xff00) | v; break;
+	case 0x0b: m.rbcr = (m.rbcr & 0x00ff) | v << 8; break;
+	case 0x0c: m.rcr = v; break;
+	case 0x0d: m.tcr = v; break;
+	case 0x0e: m.dcr = v; break;
+	case 0x0f: m.imr = v; break;
+	}
+}
+
+static unsigned long offset(const volatile void *addr)
+{
+	unsigned long off = (const unsigned char *)addr - m.win;
+
+	if (off >= MODEL_WIN_SIZE)
+		abort();
+	return off;
+}
+
+/* register number, or -1 for anything else in the window */
+static int reg_of(unsigned long off)
+{
+	if (off < XS100_REGS || off >= XS100_REGS + 4 * 0x20 || (off & 3))
+		return -1;
+	return (off - XS100_REGS) / 4;
+}
+
+static bool in_area(unsigned long off, unsigned long base)
+{
+	return off >= base && off < base + XS100_AREA_SIZE;
+}
+
+uint8_t model_readb(const volatile void *addr)
+{
+	int n = reg_of(offset(addr));
+	uint8_t v = 0;		/* the rest of the board's space reads as 0 */
+
+	model_stats.rd8++;
+	bus(1);
+	if (n >= 0)
+		v = reg_read(n);
+	bus_done();
+	return v;
+}
+
+void model_writeb(uint8_t val, volatile void *addr)
+{
+	int n = reg_of(offset(addr));
+
+	model_stats.wr8++;
+	bus(1);
+	if (n >= 0)
+		reg_write(n, val);
+	bus_done();
+}
+
+/* words and longwords keep memory order, as the board's byte lanes do */
+uint16_t model_readw(const volatile void *addr)
+{
+	unsigned long off = offset(addr);
+	uint8_t b[2] = { 0xff, 0xff };
+	uint16_t v;
+
+	model_stats.rd16++;
+	bus(1);
+	if (off == XS100_IRQSTATUS) {
+		v = irq_line() ? 0x8000 : 0;
+	} else {
+		if (reg_of(off) == REG_DATA) {
+			b[0] = dma_in();
+			b[1] = dma_in();
+		}
+		memcpy(&v, b, 2);
+	}
+	bus_done();
+	return v;
+}
+
+void model_writew(uint16_t val, volatile void *addr)
+{
+	uint8_t b[2];
+
+	model_stats.wr16++;
+	bus(1);
+	if (reg_of(offset(addr)) == REG_DATA) {
+		memcpy(b, &val, 2);
+		dma_out(b[0]);
+		dma_out(b[1]);
+	}
+	bus_done();
+}
+
+uint32_t model_readl(const volatile void *addr)
+{
+	uint8_t b[4] = { 0xff, 0xff, 0xff, 0xff };
+	uint32_t v;
+	int i;
+
+	model_stats.rd32++;
+	bus(2);
+	if (in_area(offset(addr), XS100_READ32))
+		for (i = 0; i < 4; i++)
+			b[i] = dma_in();
+	memcpy(&v, b, 4);
+	bus_done();
+	return v;
+}
+
+void model_writel(uint32_t val, volatile void *addr)
+{
+	uint8_t b[4];
+	int i;
+
+	model_stats.wr32++;
+	bus(2);
+	if (in_area(offset(addr), XS100_WRITE32)) {
+		memcpy(b, &val, 4);
+		for (i = 0; i < 4; i++)
+			dma_out(b[i]);
+	}
+	bus_done();
+}
+
+void model_init(const unsigned char *mac, unsigned int cycle_ns)
+{
+	int i;
+
+	free(m.win);
+	memset(&m, 0, sizeof(m));
+	memset(&model_stats, 0, sizeof(model_stats));
+	m.win = calloc(1, MODEL_WIN_SIZE);
+	if (!m.win)
+		abort();
+	m.cycle_ns = cycle_ns;
+
+	/* word-wide PROM: each address byte doubled */
+	for (i = 0; i < 16; i++)
+		m.mem[2 * i] = m.mem[2 * i + 1] = i < 6 ? mac[i] : 0x57;
+
+	reset();
+	model_stats.resets = 0;
+}
+
+void model_set_wire(model_rx_src_t src, model_tx_sink_t sink, void *ctx)
+{
+	m.src = src;
+	m.sink = sink;
+	m.ctx = ctx;
+	rx_fetch();
+}
+
+void *model_map(unsigned long off)
+{
+	return m.win + off;
+}
+
+uint64_t model_now(void)
+{
+	return m.now;
+}
+
+uint64_t model_next_event(void)
+{
+	uint64_t t = UINT64_MAX;
+
+	if (m.txing)
+		t = m.tx_done;
+	if (m.have_rx && m.rx.t < t)
+		t = m.rx.t;
+	return t;
+}
+
+void model_advance(uint64_t ns)
+{
+	sync(m.now + ns);
+	bus_done();
+}
+
+bool model_irq(void)
+{
+	return irq_line();
+}
@@ -0,0 +1,81 @@
+/*
+ * Software model of an AX88796 on an X-Surf 100, for ax88796-bench.
+ *
+ * The model owns a fake Zorro window laid out like the board's: the
+ * XS100 interrupt status word, the 8390 registers at a stride of 4 and
+ * the 32-bit FIFO windows. The driver reaches it through the
+ * ax_read*()/ax_write*() accessor overrides; every access is charged in
+ * bus cycles and advances the model clock, which is the only clock the
+ * harness has.
+ */
+#ifndef _AX88796_MODEL_H
+#define _AX88796_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MODEL_WIN_SIZE		0xa000	/* registers up to the end of data32 */
+#define MODEL_FRAME_MAX		1536
+
+struct model_frame {
+	uint64_t t;			/* ns, arrival on the wire */
+	unsigned int len;		/* without FCS */
+	unsigned char data[MODEL_FRAME_MAX];
+};
+
+/* next frame the wire offers the board; false if none (yet) */
+typedef bool (*model_rx_src_t)(void *ctx, struct model_frame *f);
+/* frame the board put on the wire */
+typedef void (*model_tx_sink_t)(void *ctx, const unsigned char *data,
+				unsigned int len, uint64_t t);
+
+struct model_stats {
+	/* bus accesses and their cost */
+	uint64_t rd8, wr8, rd16, wr16, rd32, wr32;
+	uint64_t cycles;
+
+	/* receive side, as the chip saw it */
+	uint64_t rx_wire;		/* frames offered by the wire */
+	uint64_t rx_ring;		/* frames written to the ring */
+	uint64_t rx_missed;		/* no room, or OVW still pending */
+	uint64_t rx_stopped;		/* arrived while the NIC was stopped */
+	uint64_t rx_filtered;		/* not for us */
+	uint64_t overflows;		/* times OVW was raised */
+
+	/* transmit side */
+	uint64_t tx_wire;		/* frames put on the wire */
+	uint64_t tx_loop;		/* frames sent in internal loopback */
+	uint64_t tx_lost;		/* in flight at a reset */
+
+	uint64_t dma_stray;		/* data port/FIFO bytes without a DMA */
+	uint64_t resets;
+};
+
+extern struct model_stats model_stats;
+
+/* called after an access or idle time leaves the interrupt line asserted */
+extern void (*model_irq_hook)(void);
+
+/* 100BASE-TX: frame plus FCS, preamble and interframe gap, 80 ns a byte */
+static inline uint64_t model_wire_ns(unsigned int len)
+{
+	return (uint64_t)((len < 60 ? 60 : len) + 4 + 8 + 12) * 80;
+}
+
+void model_init(const unsigned char *mac, unsigned int cycle_ns);
+void model_set_wire(model_rx_src_t src, model_tx_sink_t sink, void *ctx);
+void *model_map(unsigned long off);
+
+uint8_t model_readb(const volatile void *addr);
+void model_writeb(uint8_t val, volatile void *addr);
+uint16_t model_readw(const volatile void *addr);
+void model_writew(uint16_t val, volatile void *addr);
+uint32_t model_readl(const volatile void *addr);
+void model_writel(uint32_t val, volatile void *addr);
+
+uint64_t model_now(void);
+uint64_t model_next_event(void);
+void model_advance(uint64_t ns);
+bool model_irq(void);
+
+#endif
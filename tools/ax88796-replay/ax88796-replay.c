@@ -0,0 +1,758 @@
+/*
+ * ax88796-replay: runs a register trace captured with CONFIG_AX88796_TRACE
+ * (debugfs ax88796/<board>/trace, or ax88796-bench -T) through the driver
+ * core again, offline and deterministically.
+ *
+ * ax88796.c (with lib8390.c) is compiled in here unchanged, as in
+ * tools/ax88796-bench, and probed and opened against the bench's model.
+ * Then every driver core entry the trace marks (open, close, interrupt,
+ * Tx work, Tx timeout) is called in turn, with the ax_read*()/ax_write*()
+ * accessors playing the recorded accesses back: a read returns what the
+ * board returned then, a FIFO burst the recorded bytes (zeroes past the
+ * trace_data the capture kept), and every access is checked against the
+ * trace. Frames handed to xmit are rebuilt to the recorded length, so Tx
+ * data, through the FIFO or the data port, is not compared. An entry
+ * recorded in the middle of another one, an interrupt during the Tx
+ * work, say, is taken at the same point of the access sequence.
+ *
+ * The first access that differs from the trace is reported along with
+ * the entry it belongs to. Playback turns loose from there to the end of
+ * that entry: reads are served from the next recorded access to the same
+ * register and writes are not checked, so that a changed driver can
+ * usually find its way back. Per entry point, the report compares the
+ * accesses and FIFO bytes of the trace with those of the replay: the
+ * cost of a change on the exact register sequence a board produced, such
+ * as an Rx pointer mismatch or an overrun storm.
+ *
+ * The trace has to start at an open, as it does with trace=2 set before
+ * the interface comes up; otherwise the driver state at its start is the
+ * model's and the first entries are likely to differ. Faults injected by
+ * CONFIG_AX88796_FAULT_INJECT are not in the trace, so a capture taken
+ * with them differs wherever one hit.
+ */
+#include <getopt.h>
+
+#include "model.h"
+
+static u8 rp_readb(const volatile void *addr);
+static void rp_writeb(u8 val, volatile void *addr);
+static u16 rp_readw(const volatile void *addr);
+static void rp_writew(u16 val, volatile void *addr);
+static u32 rp_readl(const volatile void *addr);
+static void rp_writel(u32 val, volatile void *addr);
+
+#define ax_readb(_a) rp_readb(_a)
+#define ax_writeb(_v, _a) rp_writeb(_v, _a)
+#define ax_readw(_a) rp_readw(_a)
+#define ax_writew(_v, _a) rp_writew(_v, _a)
+#define ax_readl(_a) rp_readl(_a)
+#define ax_writel(_v, _a) rp_writel(_v, _a)
+
+#include "../../ax88796.c"
+
+#define RP_ZBASE	0x00ea0000UL	/* as ax88796-bench */
+#define RP_CYCLE	560		/* ns per access, Zorro II */
+
+static const unsigned char rp_mac[ETH_ALEN] = {
+	0x00, 0x0d, 0xb9, 0x12, 0x34, 0x56
+};
+
+/* the trace, as read back from debugfs */
+struct rec {
+	u64 ns;
+	u32 off;
+	union {
+		u32 val;
+		u8 data[4];
+	};
+	u8 kind;
+	size_t leave;			/* AX_TR_ENTER: its AX_TR_LEAVE */
+};
+
+static struct rec *recs;
+static size_t nrecs;
+
+/* per entry point, what the trace did and what the replay did */
+struct rp_stats {
+	unsigned long blocks, diverged;
+	unsigned long traced, replayed;		/* register accesses */
+	unsigned long fifo_traced, fifo_replayed; /* FIFO bytes */
+};
+
+static struct rp_stats stats[AX_CTX_NR];
+static unsigned long outside;		/* accesses outside any entry */
+static unsigned long rx_frames, tx_frames;
+
+/* the entry being played back */
+static struct {
+	bool on;
+	size_t blk;			/* its AX_TR_ENTER */
+	size_t pos;			/* next record */
+	bool loose;			/* past the first divergence */
+	size_t fifo_data;		/* current burst: first data record */
+	unsigned int fifo_ndata, fifo_off, fifo_left;
+} rp;
+
+static struct net_device *rp_dev;
+static u64 rp_t0, rp_ns0;		/* model time at the first record */
+
+/* options */
+static unsigned int opt_report = 10;	/* divergences printed */
+static unsigned int diverged;
+
+static int kind_index(const char *name)
+{
+	int i;
+
+	for (i = 0; i < AX_TR_KINDS; i++)
+		if (!strcmp(name, ax_trace_kinds[i]))
+			return i;
+	return -1;
+}
+
+static int ctx_index(const char *name)
+{
+	int i;
+
+	for (i = 0; i < AX_CTX_NR; i++)
+		if (!strcmp(name, ax_trace_ctxs[i]))
+			return i;
+	return -1;
+}
+
+static bool is_access(int kind)
+{
+	return kind <= AX_TR_WR16;
+}
+
+static bool is_write(int kind)
+{
+	return kind == AX_TR_WR8 || kind == AX_TR_WR16 ||
+	       kind == AX_TR_FIFO_OUT;
+}
+
+/* written values that are checked: not the rebuilt Tx frames */
+static bool is_checked(int kind, unsigned int off)
+{
+	return is_write(kind) && kind != AX_TR_FIFO_OUT && off != NE_DATAPORT;
+}
+
+/* trace lines: ns kind offset value, see ax_trace_show() */
+static int load(const char *path)
+{
+	const struct ax_bus_ops *bus = ax_bus(netdev_priv(rp_dev));
+	FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	unsigned long total = 0, lineno = 0, size = 0;
+	unsigned int base = 0, stride = 0;
+	char line[128], kind[16], arg[32], endian[8] = "";
+	size_t *open_at = NULL, depth = 0, i;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		struct rec *r;
+		unsigned long long ns;
+		unsigned int off;
+		int k;
+
+		lineno++;
+		if (line[0] == '#') {
+			if (sscanf(line,
+				   "# %lu records, reg_base %x stride %u, %7s",
+				   &total, &base, &stride, endian) != 4) {
+				fprintf(stderr, "%s:%lu: not a trace header\n",
+					path, lineno);
+				return -1;
+			}
+			continue;
+		}
+		if (sscanf(line, "%llu %15s %x %31s",
+			   &ns, kind, &off, arg) != 4 ||
+		    (k = kind_index(kind)) < 0) {
+			fprintf(stderr, "%s:%lu: bad record\n", path, lineno);
+			return -1;
+		}
+
+		if (nrecs == size) {
+			size = size ? size * 2 : 65536;
+			recs = realloc(recs, size * sizeof(*recs));
+			open_at = realloc(open_at, size * sizeof(*open_at));
+			if (!recs || !open_at)
+				panic("out of memory\n");
+		}
+		r = &recs[nrecs];
+		r->ns = ns;
+		r->off = off;
+		r->kind = k;
+
+		switch (k) {
+		case AX_TR_DATA:
+			if (sscanf(arg, "%2hhx%2hhx%2hhx%2hhx",
+				   &r->data[0], &r->data[1],
+				   &r->data[2], &r->data[3]) != 4) {
+				fprintf(stderr, "%s:%lu: bad data\n",
+					path, lineno);
+				return -1;
+			}
+			break;
+		case AX_TR_ENTER:
+		case AX_TR_LEAVE:
+			r->val = ctx_index(arg);
+			if ((int)r->val < 0) {
+				fprintf(stderr, "%s:%lu: unknown entry %s\n",
+					path, lineno, arg);
+				return -1;
+			}
+			if (k == AX_TR_ENTER) {
+				r->leave = SIZE_MAX;
+				open_at[depth++] = nrecs;
+			} else if (depth &&
+				   recs[open_at[depth - 1]].val == r->val) {
+				recs[open_at[--depth]].leave = nrecs;
+			}
+			break;
+		default:
+			r->val = strtoul(arg, NULL, 0);
+			/* data port words, in the capture's byte order */
+			if ((k == AX_TR_RD16 || k == AX_TR_WR16) &&
+			    strcmp(endian, AX_TRACE_ENDIAN))
+				r->val = __builtin_bswap16(r->val);
+		}
+		nrecs++;
+	}
+	if (f != stdin)
+		fclose(f);
+	free(open_at);
+
+	if (!endian[0]) {
+		fprintf(stderr, "%s: no trace header\n", path);
+		return -1;
+	}
+	if (base != bus->reg_base || stride != bus->reg_stride)
+		fprintf(stderr,
+			"%s: reg_base %#x stride %u, built for %#x and %u\n",
+			path, base, stride, bus->reg_base, bus->reg_stride);
+	if (total > nrecs)
+		fprintf(stderr, "%s: the ring wrapped, %lu records lost\n",
+			path, total - nrecs);
+	for (i = 0; i < nrecs && recs[i].kind != AX_TR_ENTER; i++)
+		;
+	if (i == nrecs || recs[i].val != AX_CTX_OPEN)
+		fprintf(stderr, "%s: does not start at an open\n", path);
+	return 0;
+}
+
+/* the model clock follows the trace */
+static void clock_to(const struct rec *r)
+{
+	u64 t = rp_t0 + (r->ns - rp_ns0);
+
+	if (t > model_now())
+		model_advance(t - model_now());
+}
+
+static void describe(const char *who, int kind, unsigned int off,
+		     unsigned int val, bool known)
+{
+	if (kind < 0)
+		printf("%s leaves the %s", who,
+		       ax_trace_ctxs[recs[rp.blk].val]);
+	else if (kind == AX_TR_FIFO_IN || kind == AX_TR_FIFO_OUT)
+		printf(known ? "%s %s %u bytes" : "%s %s", who,
+		       ax_trace_kinds[kind], val);
+	else if (known || is_write(kind))
+		printf("%s %s %#x %#x", who, ax_trace_kinds[kind], off, val);
+	else
+		printf("%s %s %#x", who, ax_trace_kinds[kind], off);
+}
+
+/*
+ * First divergence in an entry: the replay did @kind (-1 for nothing
+ * more) where the trace has @t (NULL for the end of the entry).
+ */
+static void report(int kind, unsigned int off, unsigned int val,
+		   const struct rec *t)
+{
+	const struct rec *b = &recs[rp.blk];
+
+	stats[b->val].diverged++;
+	rp.loose = true;
+	if (++diverged > opt_report)
+		return;
+
+	printf("%s at %llu ns, record %zu: ", ax_trace_ctxs[b->val],
+	       (unsigned long long)(b->ns - rp_ns0), rp.pos);
+	describe("replay", kind, off, val, false);
+	printf(", ");
+	if (t)
+		describe("trace", t->kind, t->off, t->val, true);
+	else
+		describe("trace", -1, 0, 0, true);
+	printf("\n");
+}
+
+static void play_block(size_t i);
+static void play_xmit(const struct rec *r);
+
+/*
+ * The trace record for an access of @kind to @off, writing @val; NULL if
+ * there is none. Entries recorded before it are played first.
+ */
+static const struct rec *next(int kind, unsigned int off, unsigned int val)
+{
+	const struct rec *b = &recs[rp.blk];
+	struct rp_stats *st = &stats[b->val];
+	const struct rec *r;
+	size_t i;
+
+	if (kind == AX_TR_FIFO_IN || kind == AX_TR_FIFO_OUT)
+		st->fifo_replayed += 4;
+	else
+		st->replayed++;
+
+	if (rp.fifo_left && !rp.loose) {
+		struct rec more = {
+			.kind = recs[rp.fifo_data - 1].kind,
+			.val = rp.fifo_left,
+		};
+
+		report(kind, off, val, &more);
+	}
+	rp.fifo_left = 0;
+
+	for (;;) {
+		if (rp.pos >= b->leave) {
+			if (!rp.loose)
+				report(kind, off, val, NULL);
+			return NULL;
+		}
+		r = &recs[rp.pos];
+		if (r->kind == AX_TR_ENTER) {
+			play_block(rp.pos);
+			continue;
+		}
+		if (r->kind == AX_TR_XMIT) {
+			play_xmit(r);
+			rp.pos++;
+			continue;
+		}
+		if (r->kind == AX_TR_DATA || r->kind == AX_TR_LEAVE) {
+			rp.pos++;	/* left over from a loose burst */
+			continue;
+		}
+		break;
+	}
+
+	if (r->kind == kind && r->off == off &&
+	    (!is_checked(kind, off) || r->val == val)) {
+		rp.pos++;
+		clock_to(r);
+		return r;
+	}
+	if (!rp.loose)
+		report(kind, off, val, r);
+
+	/* loose: the next access to the same place, up to the next entry */
+	for (i = rp.pos; i < b->leave && recs[i].kind != AX_TR_ENTER; i++)
+		if (recs[i].kind == kind && recs[i].off == off) {
+			rp.pos = i + 1;
+			clock_to(&recs[i]);
+			return &recs[i];
+		}
+	/* or a read gets what the register last returned in this entry */
+	if (!is_write(kind))
+		for (i = rp.pos; i-- > rp.blk; )
+			if (recs[i].kind == kind && recs[i].off == off)
+				return &recs[i];
+	return NULL;
+}
+
+static unsigned int reg_off(const volatile void *addr)
+{
+	struct ei_device *ei_local = netdev_priv(rp_dev);
+
+	return (const volatile u8 *)addr - (const volatile u8 *)ei_local->mem;
+}
+
+static unsigned int access(int kind, const volatile void *addr,
+			   unsigned int val)
+{
+	const struct rec *r;
+
+	/* a loop the trace cannot end still times out */
+	model_advance(RP_CYCLE);
+	r = next(kind, reg_off(addr), val);
+
+	return r ? r->val : 0;
+}
+
+static u8 rp_readb(const volatile void *addr)
+{
+	if (!rp.on)
+		return model_readb(addr);
+	return access(AX_TR_RD8, addr, 0);
+}
+
+static void rp_writeb(u8 val, volatile void *addr)
+{
+	if (!rp.on)
+		model_writeb(val, addr);
+	else
+		access(AX_TR_WR8, addr, val);
+}
+
+static u16 rp_readw(const volatile void *addr)
+{
+	if (!rp.on)
+		return model_readw(addr);
+	return access(AX_TR_RD16, addr, 0);
+}
+
+static void rp_writew(u16 val, volatile void *addr)
+{
+	if (!rp.on)
+		model_writew(val, addr);
+	else
+		access(AX_TR_WR16, addr, val);
+}
+
+/* one FIFO longword: starts the next recorded burst when needed */
+static u32 fifo(int kind)
+{
+	const struct rec *r;
+	unsigned int n;
+	u32 v = 0;
+
+	model_advance(RP_CYCLE);
+	if (!rp.fifo_left) {
+		r = next(kind, 0, 0);
+		if (!r)
+			return 0;
+		rp.fifo_data = rp.pos;
+		rp.fifo_ndata = 0;
+		while (rp.pos < recs[rp.blk].leave &&
+		       recs[rp.pos].kind == AX_TR_DATA) {
+			rp.pos++;
+			rp.fifo_ndata++;
+		}
+		rp.fifo_off = 0;
+		rp.fifo_left = r->val;
+	} else {
+		stats[recs[rp.blk].val].fifo_replayed += 4;
+	}
+
+	n = rp.fifo_off / 4;
+	if (n < rp.fifo_ndata && recs[rp.fifo_data + n].off == rp.fifo_off)
+		memcpy(&v, recs[rp.fifo_data + n].data, 4);
+	rp.fifo_off += 4;
+	rp.fifo_left -= min(rp.fifo_left, 4U);
+	return v;
+}
+
+static u32 rp_readl(const volatile void *addr)
+{
+	if (!rp.on)
+		return model_readl(addr);
+	return fifo(AX_TR_FIFO_IN);
+}
+
+static void rp_writel(u32 val, volatile void *addr)
+{
+	if (!rp.on)
+		model_writel(val, addr);
+	else
+		fifo(AX_TR_FIFO_OUT);
+}
+
+/* what the trace did within the entry at @i, nested ones excluded */
+static void count_traced(size_t i)
+{
+	struct rp_stats *st = &stats[recs[i].val];
+	size_t j;
+
+	for (j = i + 1; j < recs[i].leave; j++) {
+		if (recs[j].kind == AX_TR_ENTER) {
+			if (recs[j].leave == SIZE_MAX)
+				break;
+			j = recs[j].leave;
+			continue;
+		}
+		if (is_access(recs[j].kind))
+			st->traced++;
+		else if (recs[j].kind == AX_TR_FIFO_IN ||
+			 recs[j].kind == AX_TR_FIFO_OUT)
+			st->fifo_traced += recs[j].val;
+	}
+}
+
+/* the driver core entry recorded at @i, nested in the current one or not */
+static void play_block(size_t i)
+{
+	struct ei_device *ei_local = netdev_priv(rp_dev);
+	typeof(rp) outer = rp;
+	const struct rec *r = &recs[i];
+
+	if (r->leave == SIZE_MAX) {
+		/* cut off by the end of the capture, or unbalanced */
+		rp.pos = i + 1;
+		return;
+	}
+
+	stats[r->val].blocks++;
+	count_traced(i);
+	clock_to(r);
+
+	rp.on = true;
+	rp.blk = i;
+	rp.pos = i + 1;
+	rp.loose = false;
+	rp.fifo_left = 0;
+
+	switch (r->val) {
+	case AX_CTX_OPEN:
+		ax_ei_open(rp_dev);
+		break;
+	case AX_CTX_CLOSE:
+		ax_ei_close(rp_dev);
+		break;
+	case AX_CTX_IRQ:
+		wrap_ax_ei_interrupt(IRQ_AMIGA_PORTS, rp_dev);
+		break;
+	case AX_CTX_TX_WORK:
+		/* run when the trace says, not when it was queued here */
+		cancel_work_sync(&ei_local->tx_work);
+		ei_local->tx_work.func(&ei_local->tx_work);
+		break;
+	case AX_CTX_TX_TIMEOUT:
+		rp_dev->netdev_ops->ndo_tx_timeout(rp_dev);
+		break;
+	}
+
+	/* entries nested after the last access still run */
+	while (rp.pos < r->leave) {
+		const struct rec *t = &recs[rp.pos];
+
+		if (t->kind == AX_TR_ENTER) {
+			play_block(rp.pos);
+			continue;
+		}
+		if (t->kind == AX_TR_XMIT)
+			play_xmit(t);
+		else if (!rp.loose && t->kind != AX_TR_DATA &&
+			 t->kind != AX_TR_LEAVE)
+			report(-1, 0, 0, t);
+		rp.pos++;
+	}
+	clock_to(&recs[r->leave]);
+
+	outer.pos = r->leave + 1;
+	rp = outer;
+}
+
+/* the stack hands the driver a frame of the recorded length and queue */
+static void play_xmit(const struct rec *r)
+{
+	struct ei_device *ei_local = netdev_priv(rp_dev);
+	unsigned int len = max(r->val, (u32)ETH_HLEN);
+	struct sk_buff *skb;
+
+	skb = netdev_alloc_skb(rp_dev, len);
+	if (!skb)
+		panic("out of memory\n");
+	memset(skb_put(skb, len), 0, len);
+	memset(skb->data, 0xff, ETH_ALEN);
+	memcpy(skb->data + ETH_ALEN, rp_mac, ETH_ALEN);
+	skb->queue_mapping = min(r->off, EI_TX_QUEUES - 1U);
+
+	tx_frames++;
+	if (rp_dev->netdev_ops->ndo_start_xmit(skb, rp_dev) != NETDEV_TX_OK)
+		kfree_skb(skb);
+	cancel_work_sync(&ei_local->tx_work);
+}
+
+static void play(void)
+{
+	size_t i = 0;
+
+	rp_t0 = model_now();
+	rp_ns0 = nrecs ? recs[0].ns : 0;
+
+	while (i < nrecs) {
+		const struct rec *r = &recs[i];
+
+		if (r->kind == AX_TR_ENTER && r->leave != SIZE_MAX) {
+			play_block(i);
+			i = r->leave + 1;
+			continue;
+		}
+		if (r->kind == AX_TR_XMIT)
+			play_xmit(r);
+		else if (is_access(r->kind))
+			outside++;		/* PHY, link and probe */
+		i++;
+	}
+}
+
+/* kshim services the harness provides */
+void kshim_rx(struct sk_buff *skb)
+{
+	rx_frames++;
+	kfree_skb(skb);
+}
+
+u64 kshim_now(void)
+{
+	return model_now();
+}
+
+void kshim_idle(u64 ns)
+{
+	model_advance(ns);
+}
+
+/* the trace says when the handler runs */
+bool kshim_irq_asserted(int irq)
+{
+	return false;
+}
+
+/* the Zorro bus, with one X-Surf 100 on it, as the bench's */
+static struct zorro_dev rp_zdev = {
+	.resource = { RP_ZBASE, RP_ZBASE + 0xffff },
+	.dev = { .init_name = "xsurf100.0" },
+};
+
+void *request_mem_region(unsigned long start, unsigned long n, const char *name)
+{
+	return (void *)name;
+}
+
+void release_mem_region(unsigned long start, unsigned long n)
+{
+}
+
+void *z_ioremap(unsigned long phys, unsigned long size)
+{
+	if (phys < RP_ZBASE || phys + size > RP_ZBASE + MODEL_WIN_SIZE)
+		return NULL;
+	return model_map(phys - RP_ZBASE);
+}
+
+void z_iounmap(void *addr)
+{
+}
+
+int zorro_register_driver(struct zorro_driver *drv)
+{
+	rp_zdev.id = drv->id_table[0].id;
+	return drv->probe(&rp_zdev, &drv->id_table[0]);
+}
+
+void zorro_unregister_driver(struct zorro_driver *drv)
+{
+	drv->remove(&rp_zdev);
+}
+
+static void print_stats(void)
+{
+	int i;
+
+	printf("%-11s %7s %8s %9s %9s %11s %11s\n", "entry", "runs",
+	       "diverged", "accesses", "replayed", "fifo bytes", "replayed");
+	for (i = 0; i < AX_CTX_NR; i++) {
+		struct rp_stats *st = &stats[i];
+
+		if (!st->blocks)
+			continue;
+		printf("%-11s %7lu %8lu %9lu %9lu %11lu %11lu\n",
+		       ax_trace_ctxs[i], st->blocks, st->diverged,
+		       st->traced, st->replayed,
+		       st->fifo_traced, st->fifo_replayed);
+	}
+	printf("\n%zu records, %lu accesses outside the driver core, "
+	       "%lu frames sent, %lu received\n",
+	       nrecs, outside, tx_frames, rx_frames);
+	if (diverged > opt_report)
+		printf("%u divergences not shown\n", diverged - opt_report);
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: ax88796-replay [options] trace\n"
+		"  -n count     divergences printed (%u)\n"
+		"  -p name=val  driver parameter: dma_chunk, rx_watermark,\n"
+		"               tx_reserve\n"
+		"  -v           driver messages, twice for debug\n"
+		"trace is a debugfs ax88796/*/trace dump, - for stdin\n",
+		opt_report);
+	exit(2);
+}
+
+static void set_param(char *arg)
+{
+	char *eq = strchr(arg, '=');
+	unsigned int v;
+
+	if (!eq || kstrtouint(eq + 1, 0, &v))
+		usage();
+	*eq = 0;
+
+	if (!strcmp(arg, "dma_chunk"))
+		dma_chunk = v;
+	else if (!strcmp(arg, "rx_watermark"))
+		rx_watermark = v;
+	else if (!strcmp(arg, "tx_reserve"))
+		tx_reserve = v;
+	else
+		usage();
+}
+
+int main(int argc, char **argv)
+{
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "n:p:vh")) != -1) {
+		switch (c) {
+		case 'n': opt_report = strtoul(optarg, NULL, 0); break;
+		case 'p': set_param(optarg); break;
+		case 'v': kshim_loglevel++; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1)
+		usage();
+
+	model_init(rp_mac, RP_CYCLE);
+
+	ret = ax_init_module();
+	if (ret) {
+		fprintf(stderr, "probe failed: %d\n", ret);
+		return 1;
+	}
+	rp_dev = zorro_get_drvdata(&rp_zdev);
+
+	/* up against the model; from here on the trace drives the board */
+	ret = kshim_dev_open(rp_dev);
+	if (ret) {
+		fprintf(stderr, "open failed: %d\n", ret);
+		return 1;
+	}
+	cancel_delayed_work_sync(&to_ax_dev(rp_dev)->link_work);
+
+	if (load(argv[optind]))
+		return 1;
+	play();
+	print_stats();
+
+	kshim_dev_close(rp_dev);
+	ax_exit_module();
+	free(recs);
+	if (kshim_stats.skbs)
+		fprintf(stderr, "%llu skbs leaked\n",
+			(unsigned long long)kshim_stats.skbs);
+	return diverged ? 3 : 0;
+}
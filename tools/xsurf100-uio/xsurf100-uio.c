@@ -0,0 +1,472 @@
+/*
+ * xsurf100-uio: poll-mode userspace driver for X-Surf 100 boards that the
+ * kernel handed to UIO (ax88796 uio_mode=1).
+ *
+ * ax88796.c (with lib8390.c) is compiled in here unchanged, as in
+ * tools/ax88796-bench, so the ring handling, the Tx staging and the FIFO
+ * copy kernels (movem.l on m68k) are the driver's own. Only the
+ * ax_read*()/ax_write*() accessors differ: they go to the two UIO maps,
+ * map 0 for the 8390 registers and map 1 for the 32-bit data FIFO. The
+ * kernel services come from the bench's kshim.c.
+ *
+ * The board's interrupt output must stay masked, since INT2 is shared
+ * and has no handler behind it. So writes to IMR are kept in a shadow
+ * and the chip's copy stays 0. Pending interrupts are ISR & shadow,
+ * polled from the main loop and from every delay, and the X-Surf
+ * interrupt status register reads back that result. The PHY is read over
+ * the driver's bitbanged MDIO.
+ *
+ * Runs the offline loopback self test on request, then counts what
+ * arrives and optionally sends numbered test frames, once a second
+ * printing what went by.
+ */
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static u8 uio_readb(const volatile void *addr);
+static void uio_writeb(u8 val, volatile void *addr);
+static u16 uio_readw(const volatile void *addr);
+
+#define ax_readb(_a) uio_readb(_a)
+#define ax_writeb(_v, _a) uio_writeb(_v, _a)
+#define ax_readw(_a) uio_readw(_a)
+#define ax_writew(_v, _a) (*(volatile u16 *)(_a) = (_v))
+#define ax_readl(_a) (*(const volatile u32 *)(_a))
+#define ax_writel(_v, _a) (*(volatile u32 *)(_a) = (_v))
+
+#include "../../ax88796.c"
+
+#define UIO_PROTO	0x88b5		/* as the self test */
+#define UIO_REG(r)	(XS100_8390_BASE + 4 * (r))
+
+static struct {
+	volatile u8 *regs;		/* map 0 */
+	volatile u8 *data;		/* map 1 */
+	unsigned long regs_phys, data_phys;
+	size_t regs_size, data_size;
+	u8 page;			/* CR page select, as last written */
+	u8 imr;				/* what the driver asked for */
+} uio;
+
+/* options */
+static const char *opt_dev;
+static unsigned int opt_secs = 10;
+static unsigned long opt_tx;
+static unsigned int opt_len = 60;
+static bool opt_test, opt_promisc, opt_verbose;
+
+static volatile sig_atomic_t stop;
+
+static struct {
+	unsigned long frames, bytes, test, bad;
+	u32 expect;
+} rx;
+static unsigned long tx_sent;
+static u32 tx_seq;
+
+/* register accessors: the chip's IMR stays 0, see the top of the file */
+static bool uio_pending(void)
+{
+	if (uio.page != 0)		/* ISR is only visible in page 0 */
+		return false;
+	return uio.regs[UIO_REG(0x07)] & uio.imr;
+}
+
+static u8 uio_readb(const volatile void *addr)
+{
+	return *(const volatile u8 *)addr;
+}
+
+static void uio_writeb(u8 val, volatile void *addr)
+{
+	uintptr_t off = (uintptr_t)addr - (uintptr_t)uio.regs;
+
+	if (off == UIO_REG(0x00)) {
+		uio.page = val >> 6;
+	} else if (off == UIO_REG(0x0f) && uio.page == 0) {
+		uio.imr = val;
+		val = 0;
+	}
+	*(volatile u8 *)addr = val;
+}
+
+static u16 uio_readw(const volatile void *addr)
+{
+	uintptr_t off = (uintptr_t)addr - (uintptr_t)uio.regs;
+
+	if (off == XS100_IRQSTATUS_BASE)
+		return uio_pending() ? 0x8000 : 0;
+	return *(const volatile u16 *)addr;
+}
+
+/* kshim services the harness provides */
+u64 kshim_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+bool kshim_irq_asserted(int irq)
+{
+	return irq == IRQ_AMIGA_PORTS && uio_pending();
+}
+
+static void uio_poll(void)
+{
+	if (kshim_irq_asserted(IRQ_AMIGA_PORTS))
+		kshim_irq(IRQ_AMIGA_PORTS);
+}
+
+void kshim_idle(u64 ns)
+{
+	u64 end = kshim_now() + ns;
+
+	do
+		uio_poll();
+	while (kshim_now() < end);
+}
+
+void kshim_rx(struct sk_buff *skb)
+{
+	const unsigned char *eth = skb->data - ETH_HLEN;
+	u32 seq;
+
+	rx.frames++;
+	rx.bytes += skb->len + ETH_HLEN;
+	if (skb->protocol == htons(UIO_PROTO) && skb->len >= sizeof(seq)) {
+		memcpy(&seq, skb->data, sizeof(seq));
+		rx.test++;
+		if (rx.expect && seq != rx.expect)
+			rx.bad++;
+		rx.expect = seq + 1;
+	}
+	if (opt_verbose)
+		printf("rx %02x:%02x:%02x:%02x:%02x:%02x > %02x:%02x:%02x:%02x:%02x:%02x type %04x len %u\n",
+		       eth[6], eth[7], eth[8], eth[9], eth[10], eth[11],
+		       eth[0], eth[1], eth[2], eth[3], eth[4], eth[5],
+		       ntohs(skb->protocol), skb->len + ETH_HLEN);
+	kfree_skb(skb);
+}
+
+/* the Zorro bus: one board, at the physical address of map 0 */
+static struct zorro_dev uio_zdev = {
+	.dev = { .init_name = "xsurf100.0" },
+};
+
+void *request_mem_region(unsigned long start, unsigned long n, const char *name)
+{
+	return (void *)name;
+}
+
+void release_mem_region(unsigned long start, unsigned long n)
+{
+}
+
+void *z_ioremap(unsigned long phys, unsigned long size)
+{
+	if (phys >= uio.regs_phys &&
+	    phys + size <= uio.regs_phys + uio.regs_size)
+		return (void *)(uio.regs + (phys - uio.regs_phys));
+	if (phys >= uio.data_phys &&
+	    phys + size <= uio.data_phys + uio.data_size)
+		return (void *)(uio.data + (phys - uio.data_phys));
+	return NULL;
+}
+
+void z_iounmap(void *addr)
+{
+}
+
+int zorro_register_driver(struct zorro_driver *drv)
+{
+	uio_zdev.id = drv->id_table[0].id;
+	return drv->probe(&uio_zdev, &drv->id_table[0]);
+}
+
+void zorro_unregister_driver(struct zorro_driver *drv)
+{
+	drv->remove(&uio_zdev);
+}
+
+/* /sys/class/uio/uioN/maps/mapM/<name> */
+static unsigned long uio_sysfs(const char *uio_name, int map, const char *attr)
+{
+	char path[128];
+	unsigned long v = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/uio/%s/maps/map%d/%s",
+		 uio_name, map, attr);
+	f = fopen(path, "r");
+	if (!f || fscanf(f, "%lx", &v) != 1)
+		v = 0;
+	if (f)
+		fclose(f);
+	return v;
+}
+
+/* the first UIO device the kernel driver registered, or the one asked for */
+static const char *uio_find(void)
+{
+	static char found[32];
+	char path[300], name[32];
+	struct dirent *de;
+	DIR *d;
+	FILE *f;
+
+	if (opt_dev)
+		return strncmp(opt_dev, "/dev/", 5) ? opt_dev : opt_dev + 5;
+
+	d = opendir("/sys/class/uio");
+	if (!d)
+		return NULL;
+	while ((de = readdir(d)) != NULL) {
+		if (strncmp(de->d_name, "uio", 3))
+			continue;
+		snprintf(path, sizeof(path), "/sys/class/uio/%s/name",
+			 de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fgets(name, sizeof(name), f) &&
+		    !strncmp(name, "xsurf100", 8)) {
+			strlcpy(found, de->d_name, sizeof(found));
+			fclose(f);
+			closedir(d);
+			return found;
+		}
+		fclose(f);
+	}
+	closedir(d);
+	return NULL;
+}
+
+static void *uio_map(int fd, int map, size_t size)
+{
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		       (off_t)map * getpagesize());
+
+	return p == MAP_FAILED ? NULL : p;
+}
+
+static int uio_open(void)
+{
+	const char *name = uio_find();
+	char path[64];
+	int fd;
+
+	if (!name) {
+		fprintf(stderr, "no xsurf100 UIO device; load ax88796 with uio_mode=1\n");
+		return -1;
+	}
+
+	uio.regs_phys = uio_sysfs(name, 0, "addr");
+	uio.regs_size = uio_sysfs(name, 0, "size");
+	uio.data_phys = uio_sysfs(name, 1, "addr");
+	uio.data_size = uio_sysfs(name, 1, "size");
+	if (!uio.regs_size || !uio.data_size) {
+		fprintf(stderr, "%s: maps missing in sysfs\n", name);
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/%s", name);
+	fd = open(path, O_RDWR | O_SYNC);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	uio.regs = uio_map(fd, 0, uio.regs_size);
+	uio.data = uio_map(fd, 1, uio.data_size);
+	close(fd);
+	if (!uio.regs || !uio.data) {
+		perror("mmap");
+		return -1;
+	}
+
+	uio_zdev.resource.start = uio.regs_phys;
+	uio_zdev.resource.end = uio.regs_phys + 0xffff;
+	printf("%s: registers at %#lx, data32 at %#lx\n", name,
+	       uio.regs_phys, uio.data_phys);
+	return 0;
+}
+
+/* what dev_queue_xmit() would do for the test frames */
+static void uio_xmit(struct net_device *dev)
+{
+	struct sk_buff *skb;
+	unsigned char *d;
+	unsigned int i;
+
+	while (tx_sent < opt_tx && !__netif_subqueue_stopped(dev, EI_TXQ_BULK)) {
+		skb = netdev_alloc_skb(dev, opt_len);
+		if (!skb)
+			return;
+		d = skb_put(skb, opt_len);
+		memset(d, 0xff, ETH_ALEN);
+		memcpy(d + ETH_ALEN, dev->dev_addr, ETH_ALEN);
+		d[12] = UIO_PROTO >> 8;
+		d[13] = UIO_PROTO & 0xff;
+		tx_seq++;
+		memcpy(d + ETH_HLEN, &tx_seq, sizeof(tx_seq));
+		for (i = ETH_HLEN + sizeof(tx_seq); i < opt_len; i++)
+			d[i] = tx_seq + i;
+		skb->queue_mapping = EI_TXQ_BULK;
+		skb->xmit_more = opt_tx - tx_sent > 1;
+
+		if (dev->netdev_ops->ndo_start_xmit(skb, dev) != NETDEV_TX_OK) {
+			kfree_skb(skb);
+			tx_seq--;
+			return;
+		}
+		dev->trans_start = jiffies;
+		tx_sent++;
+	}
+}
+
+/* dev_watchdog() */
+static void uio_watchdog(struct net_device *dev)
+{
+	static u64 next;
+	u64 now = kshim_now();
+
+	if (now < next)
+		return;
+	next = now + (u64)dev->watchdog_timeo * (NSEC_PER_SEC / HZ);
+
+	if (dev->tx_stopped && netif_carrier_ok(dev) &&
+	    time_after(jiffies, dev->trans_start + dev->watchdog_timeo))
+		dev->netdev_ops->ndo_tx_timeout(dev);
+}
+
+static void uio_self_test(struct net_device *dev)
+{
+	struct ethtool_test test = { .flags = ETH_TEST_FL_OFFLINE };
+	int n = dev->ethtool_ops->get_sset_count(dev, ETH_SS_TEST);
+	u8 names[16][ETH_GSTRING_LEN];
+	u64 data[16];
+	int i;
+
+	if (n <= 0 || n > 16)
+		return;
+	dev->ethtool_ops->get_strings(dev, ETH_SS_TEST, &names[0][0]);
+	dev->ethtool_ops->self_test(dev, &test, data);
+
+	printf("self test: %s\n",
+	       test.flags & ETH_TEST_FL_FAILED ? "FAILED" : "passed");
+	for (i = 0; i < n; i++)
+		printf("  %-24.*s %llu\n", ETH_GSTRING_LEN, names[i],
+		       (unsigned long long)data[i]);
+}
+
+static void uio_report(struct net_device *dev, unsigned int sec)
+{
+	struct net_device_stats *s = dev->netdev_ops->ndo_get_stats(dev);
+
+	printf("%4u s  rx %lu frames %lu bytes (%lu test, %lu out of order)  "
+	       "tx %lu  errors rx %lu tx %lu  missed %lu  link %s\n",
+	       sec, rx.frames, rx.bytes, rx.test, rx.bad, tx_sent,
+	       s->rx_errors, s->tx_errors, s->rx_missed_errors,
+	       netif_carrier_ok(dev) ? "up" : "down");
+}
+
+static void uio_run(struct net_device *dev)
+{
+	u64 start = kshim_now(), tick = start + NSEC_PER_SEC;
+	unsigned int sec = 0;
+
+	while (!stop && (!opt_secs || sec < opt_secs)) {
+		kshim_run_work();
+		uio_xmit(dev);
+		uio_watchdog(dev);
+		uio_poll();
+		if (kshim_now() >= tick) {
+			tick += NSEC_PER_SEC;
+			uio_report(dev, ++sec);
+		}
+	}
+}
+
+static void uio_stop(int sig)
+{
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: xsurf100-uio [options]\n"
+		"  -d uioN      UIO device (first one named xsurf100)\n"
+		"  -t secs      run time, 0 until interrupted (%u)\n"
+		"  -x count     send count broadcast test frames\n"
+		"  -l len       test frame length (%u)\n"
+		"  -s           offline loopback self test first\n"
+		"  -P           promiscuous\n"
+		"  -v           print every frame and driver messages, twice for debug\n",
+		opt_secs, opt_len);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	struct net_device *dev;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "d:t:x:l:sPvh")) != -1) {
+		switch (c) {
+		case 'd': opt_dev = optarg; break;
+		case 't': opt_secs = strtoul(optarg, NULL, 0); break;
+		case 'x': opt_tx = strtoul(optarg, NULL, 0); break;
+		case 'l': opt_len = strtoul(optarg, NULL, 0); break;
+		case 's': opt_test = true; break;
+		case 'P': opt_promisc = true; break;
+		case 'v': opt_verbose = true; kshim_loglevel++; break;
+		default: usage();
+		}
+	}
+	if (optind < argc || opt_len < ETH_HLEN + 4 || opt_len > ETH_FRAME_LEN)
+		usage();
+	kshim_loglevel = max(kshim_loglevel, KS_INFO);
+
+	if (uio_open())
+		return 1;
+	kshim_phy_mdio = true;
+
+	ret = ax_init_module();
+	if (ret) {
+		fprintf(stderr, "probe failed: %d\n", ret);
+		return 1;
+	}
+	dev = zorro_get_drvdata(&uio_zdev);
+
+	ret = kshim_dev_open(dev);
+	if (ret) {
+		fprintf(stderr, "open failed: %d\n", ret);
+		ax_exit_module();
+		return 1;
+	}
+	if (opt_promisc) {
+		dev->flags |= IFF_PROMISC;
+		dev->netdev_ops->ndo_set_rx_mode(dev);
+	}
+
+	signal(SIGINT, uio_stop);
+	signal(SIGTERM, uio_stop);
+
+	if (opt_test)
+		uio_self_test(dev);
+	uio_run(dev);
+
+	kshim_dev_close(dev);
+	ax_exit_module();
+	if (kshim_stats.skbs)
+		fprintf(stderr, "%llu skbs leaked\n",
+			(unsigned long long)kshim_stats.skbs);
+	return 0;
+}